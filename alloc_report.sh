@@ -0,0 +1,53 @@
+#!/bin/bash
+
+## Compare allocator time in the epoll and io_uring backends with connection
+## objects from the slab (./serverbench) and from malloc (build/noslab, see
+## 'make noslab'). Each run samples the server with the SIGUSR2 profiler
+## while ab sends Connection: close requests, and reports the share of
+## samples with malloc/free on the stack. Writes alloc_report.txt.
+
+src=$(dirname "$(readlink -f "$0")")
+port=${port:-18580}
+REQUESTS=${REQUESTS:-50000}
+CONC=${CONC:-32}
+WORKERS=${WORKERS:-0}
+BACKENDS=${BACKENDS:-"epoll io_uring"}
+
+if ! command -v ab > /dev/null; then
+    echo "ERROR: ab (apache2-utils) is needed for the report."
+    exit 1
+fi
+
+cd "$src" || exit 1
+for bin in ./serverbench build/noslab/serverbench; do
+    if [[ ! -x $bin ]]; then
+	echo "ERROR: $bin is missing, run 'make all noslab'."
+	exit 1
+    fi
+done
+echo "hello" > small
+
+printf "%-9s %-7s %12s %10s %10s\n" "backend" "build" "rps" "samples" "alloc(%)" | tee alloc_report.txt
+for backend in $BACKENDS; do
+    for build in slab noslab; do
+	bin=./serverbench
+	[[ $build == noslab ]] && bin=build/noslab/serverbench
+	$bin 127.0.0.1:$port $backend $WORKERS > /dev/null &
+	pid=$!
+	sleep 0.5
+	rm -f profile.$pid.*.folded
+	kill -USR2 $pid
+	rps=$(ab -n $REQUESTS -c $CONC -H "Connection: close" http://127.0.0.1:$port/small 2>/dev/null |
+	    awk '/Requests per second/ {print $4}')
+	kill -USR2 $pid
+	sleep 0.2
+	kill -TERM $pid
+	wait $pid
+	cat profile.$pid.*.folded 2>/dev/null |
+	    awk -v b=$backend -v k=$build -v r=$rps '{n = $NF; total += n; if ($0 ~ /(malloc|free|calloc|realloc)/) alloc += n}
+		END {printf "%-9s %-7s %12.1f %10d %10.2f\n", b, k, r, total, total ? 100 * alloc / total : 0}' |
+	    tee -a alloc_report.txt
+	rm -f profile.$pid.*.folded
+	port=$((port + 1))
+    done
+done
@@ -0,0 +1,72 @@
+#!/bin/bash
+
+## Compare the glibc allocator with the jemalloc/tcmalloc/mimalloc builds
+## ('make allocators') under both servers. For each build and server it runs
+## ab over a mix of file sizes and reports the mean requests/s, the peak RSS
+## of the server process tree during the run, and the RSS still held once the
+## load is gone, over the RSS before it. That idle growth is what the
+## allocator keeps around in fragmented or cached free memory. Allocators
+## that have not been built are skipped. Writes allocator_report.txt.
+
+src=$(dirname "$(readlink -f "$0")")
+port=${port:-18680}
+REQUESTS=${REQUESTS:-10000}
+CONC=${CONC:-32}
+SIZES=${SIZES:-"1000 10000 100000 1000000"}
+ALLOCATORS=${ALLOCATORS:-"glibc jemalloc tcmalloc mimalloc"}
+
+if ! command -v ab > /dev/null; then
+    echo "ERROR: ab (apache2-utils) is needed for the report."
+    exit 1
+fi
+
+cd "$src" || exit 1
+for size in $SIZES; do
+    head -c $size < /dev/urandom > alloc_$size
+done
+
+## RSS in KiB of pid $1 and all its descendants.
+tree_rss() {
+    local total=0 p
+    for p in $1 $(pgrep -P $1); do
+	total=$((total + $(awk '/^VmRSS/ {print $2}' /proc/$p/status 2>/dev/null || echo 0)))
+    done
+    echo $total
+}
+
+printf "%-9s %-13s %12s %14s %14s %14s\n" "alloc" "server" "rps(mean)" "idle_rss_kb" "peak_rss_kb" "retained_kb" | tee allocator_report.txt
+for alloc in $ALLOCATORS; do
+    dir=build/$alloc
+    [[ $alloc == glibc ]] && dir=.
+    for bin in serverfork serverthread; do
+	if [[ ! -x $dir/$bin ]]; then
+	    echo "skipping $alloc $bin: $dir/$bin is missing, run 'make $alloc'."
+	    continue
+	fi
+	"$dir/$bin" 127.0.0.1:$port > /dev/null &
+	pid=$!
+	sleep 0.5
+	idle=$(tree_rss $pid)
+
+	rm -f tmp.rps tmp.stop
+	echo $idle > tmp.peak
+	( peak=0; while kill -0 $pid 2>/dev/null && [[ ! -e tmp.stop ]]; do
+	      r=$(tree_rss $pid); ((r > peak)) && peak=$r; echo $peak > tmp.peak; sleep 0.05
+	  done ) &
+	sampler=$!
+	for size in $SIZES; do
+	    ab -n $REQUESTS -c $CONC http://127.0.0.1:$port/alloc_$size 2>/dev/null | awk '/Requests per second/ {print $4}' >> tmp.rps
+	done
+	touch tmp.stop
+	wait $sampler
+	sleep 1
+	after=$(tree_rss $pid)
+
+	kill -TERM $pid
+	wait $pid
+	awk -v a=$alloc -v s=$bin -v idle=$idle -v peak=$(cat tmp.peak) -v after=$after '{sum += $1}
+	    END {printf "%-9s %-13s %12.1f %14d %14d %14d\n", a, s, sum/NR, idle, peak, after - idle}' tmp.rps | tee -a allocator_report.txt
+	port=$((port + 1))
+    done
+done
+rm -f tmp.rps tmp.peak tmp.stop alloc_*[0-9]
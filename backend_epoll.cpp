@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <pthread.h>
+#include <errno.h>
+
+#include "backends.h"
+#include "conn_slab.h"
+#include "hot_cache.h"
+#include "ebr.h"
+
+#define EPOLL_MAX_EVENTS 64
+#define EPOLL_WAIT_MS 1000
+
+struct epoll_worker {
+    int server_fd;
+    const struct server_config *config;
+};
+
+// Per-thread loop state; 'live' lists every open connection for the timeout
+// scan, and connections come from the loop's own slab.
+struct event_loop {
+    int epfd;
+    struct connection *live;
+    struct conn_slab slab;
+};
+
+static void loop_add(struct event_loop *loop, struct connection *c) {
+    c->prev = NULL;
+    c->next = loop->live;
+    if (loop->live) loop->live->prev = c;
+    loop->live = c;
+}
+
+static void loop_close(struct event_loop *loop, struct connection *c) {
+    if (c->prev) c->prev->next = c->next;
+    else loop->live = c->next;
+    if (c->next) c->next->prev = c->prev;
+    // Clear the table slot before close() lets another thread reuse the fd.
+    conn_table_set(c->fd, NULL);
+    connection_close(c);
+    conn_slab_free(&loop->slab, c);
+}
+
+static void close_slow_connections(struct event_loop *loop) {
+    long long now = monotonic_ms();
+    for (struct connection *c = loop->live; c;) {
+        struct connection *next = c->next;
+        if (connection_too_slow(c, now)) {
+            set_abortive_close(c->fd);
+            loop_close(loop, c);
+        }
+        c = next;
+    }
+}
+
+static void accept_connections(struct event_loop *loop, int server_fd, const struct server_config *config) {
+    while (1) {
+        int client_fd = accept4(server_fd, NULL, NULL, SOCK_NONBLOCK);
+        if (client_fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && !shutdown_requested)
+                log_error("accept failed", 0);
+            return;
+        }
+        log_accept(config, client_fd);
+
+        struct connection *c = (struct connection *)conn_slab_alloc(&loop->slab);
+        if (!c) {
+            log_error("connection slab alloc failed", 0);
+            close(client_fd);
+            continue;
+        }
+        connection_init(c, client_fd);
+        loop_add(loop, c);
+        if (conn_table_set(client_fd, c) < 0) {
+            loop_close(loop, c);
+            continue;
+        }
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.fd = client_fd;
+        if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, client_fd, &ev) < 0) {
+            log_error("epoll_ctl failed", 0);
+            loop_close(loop, c);
+        }
+    }
+}
+
+// Writes are retried on EPOLLOUT until done, so a slow reader only holds
+// its bounded output window.
+static void handle_event(struct event_loop *loop, struct connection *c, unsigned int events) {
+    int state = c->state;
+    if (state == CONN_READING && (events & (EPOLLIN | EPOLLHUP | EPOLLERR | EPOLLRDHUP)))
+        state = connection_on_readable(c);
+    if (state == CONN_WRITING) {
+        state = connection_on_writable(c);
+        if (state == CONN_WRITING && !(events & EPOLLOUT)) {
+            struct epoll_event ev;
+            ev.events = EPOLLOUT;
+            ev.data.fd = c->fd;
+            epoll_ctl(loop->epfd, EPOLL_CTL_MOD, c->fd, &ev);
+        }
+    }
+    if (state == CONN_DONE) loop_close(loop, c);
+}
+
+static void *epoll_loop(void *arg) {
+    struct epoll_worker *w = (struct epoll_worker *)arg;
+    struct event_loop loop;
+    loop.epfd = epoll_create1(0);
+    loop.live = NULL;
+    conn_slab_init(&loop.slab, sizeof(struct connection));
+    if (loop.epfd < 0) log_error("epoll_create1 failed", 1);
+    hot_cache_enable();
+
+    // EPOLLEXCLUSIVE wakes one loop per incoming connection, not all of them.
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+    ev.data.fd = w->server_fd;
+    if (epoll_ctl(loop.epfd, EPOLL_CTL_ADD, w->server_fd, &ev) < 0)
+        log_error("epoll_ctl failed", 1);
+
+    struct epoll_event events[EPOLL_MAX_EVENTS];
+    long long next_tick = monotonic_ms() + EPOLL_WAIT_MS;
+    while (!shutdown_requested) {
+        int n = epoll_wait(loop.epfd, events, EPOLL_MAX_EVENTS, EPOLL_WAIT_MS);
+        // Cached bodies finished within this batch need no reference.
+        int in_section = ebr_enter() == 0;
+        for (int i = 0; i < n; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == w->server_fd) {
+                accept_connections(&loop, w->server_fd, w->config);
+            } else {
+                struct connection *c = (struct connection *)conn_table_get(fd);
+                if (c) handle_event(&loop, c, events[i].events);
+            }
+        }
+        if (in_section) ebr_exit();
+        if (monotonic_ms() >= next_tick) {
+            close_slow_connections(&loop);
+            next_tick = monotonic_ms() + EPOLL_WAIT_MS;
+        }
+    }
+    while (loop.live) loop_close(&loop, loop.live);
+    hot_cache_disable();
+    conn_slab_destroy(&loop.slab);
+    close(loop.epfd);
+    return NULL;
+}
+
+static int run_epoll(int server_fd, const struct server_config *config) {
+    if (set_nonblocking(server_fd) < 0) log_error("fcntl failed", 1);
+    caches_start(server_fd);
+    if (conn_table_init() < 0) log_error("connection table init failed", 1);
+
+    int workers = worker_count(config);
+    pthread_t *tids = (pthread_t *)calloc(workers, sizeof(pthread_t));
+    if (!tids) log_error("calloc failed", 1);
+    struct epoll_worker worker = { server_fd, config };
+
+    for (int i = 0; i < workers; ++i) {
+        if (pthread_create(&tids[i], NULL, epoll_loop, &worker) != 0)
+            log_error("pthread_create failed", 1);
+    }
+    for (int i = 0; i < workers; ++i) pthread_join(tids[i], NULL);
+    free(tids);
+    return 0;
+}
+
+const struct server_backend epoll_backend = {
+    "epoll", "N threads, each running an epoll event loop", run_epoll
+};
@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <signal.h>
+
+#include "backends.h"
+#include "child_tracker.h"
+
+// Start a process serving client_fd; returns its pid, or -1.
+typedef pid_t (*launch_fn)(int server_fd, int client_fd, struct child_tracker *tracker);
+
+static pid_t launch_fork(int server_fd, int client_fd, struct child_tracker *tracker) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(server_fd);
+        child_tracker_child_setup(tracker);
+        install_shutdown_handler(-1);
+        process_client_request(client_fd);
+        exit(EXIT_SUCCESS);
+    }
+    return pid;
+}
+
+// serverhandler is looked up next to the running binary.
+static char handler_path[PATH_MAX];
+static char handler_header_size[24];
+static posix_spawnattr_t handler_attr;
+
+static int spawn_setup(const struct server_config *config) {
+    ssize_t len = readlink("/proc/self/exe", handler_path, sizeof(handler_path) - 1);
+    if (len < 0) return -1;
+    handler_path[len] = '\0';
+    char *slash = strrchr(handler_path, '/');
+    if (!slash || (size_t)(slash - handler_path) + sizeof("/" SPAWN_HANDLER_NAME) > sizeof(handler_path))
+        return -1;
+    strcpy(slash + 1, SPAWN_HANDLER_NAME);
+    if (access(handler_path, X_OK) < 0) return -1;
+    snprintf(handler_header_size, sizeof(handler_header_size), "%zu", config->max_header_size);
+
+    // The handler starts with the default mask, not the tracker's blocked signals.
+    sigset_t none;
+    sigemptyset(&none);
+    posix_spawnattr_init(&handler_attr);
+    posix_spawnattr_setsigmask(&handler_attr, &none);
+    posix_spawnattr_setflags(&handler_attr, POSIX_SPAWN_SETSIGMASK);
+    return 0;
+}
+
+// posix_spawn() uses CLONE_VM|CLONE_VFORK, so unlike fork() it copies no
+// page tables and costs the same however large the parent has grown.
+static pid_t launch_spawn(int server_fd, int client_fd, struct child_tracker *tracker) {
+    (void)server_fd;
+    (void)tracker;
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, client_fd, STDIN_FILENO);
+
+    char *argv[] = { handler_path, handler_header_size, NULL };
+    pid_t pid;
+    int err = posix_spawn(&pid, handler_path, &actions, &handler_attr, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (err != 0) {
+        errno = err;
+        return -1;
+    }
+    return pid;
+}
+
+// config->workers caps the number of live children (0 = DEFAULT_MAX_CHILDREN).
+static int run_children(int server_fd, const struct server_config *config, launch_fn launch) {
+    struct child_tracker tracker;
+    if (child_tracker_init(&tracker, config->workers) < 0) log_error("child tracker init failed", 1);
+
+    struct sockaddr_storage client_addr;
+    socklen_t client_addr_len = sizeof(client_addr);
+
+    while (!shutdown_requested) {
+        // At the cap only the signalfd is watched; connections wait in the backlog.
+        struct pollfd fds[2] = {
+            { tracker.fd, POLLIN, 0 },
+            { server_fd, POLLIN, 0 },
+        };
+        int nfds = child_tracker_full(&tracker) ? 1 : 2;
+        if (poll(fds, nfds, -1) < 0) {
+            if (errno != EINTR) log_error("poll failed", 0);
+            continue;
+        }
+        if (fds[0].revents) child_tracker_poll(&tracker);
+        if (nfds < 2 || !fds[1].revents || shutdown_requested) continue;
+
+        int client_fd = accept4(server_fd, (struct sockaddr *)&client_addr, &client_addr_len, SOCK_CLOEXEC);
+        if (client_fd < 0) {
+            if (!shutdown_requested) log_error("accept failed", 0);
+            continue;
+        }
+
+        log_accept(config, client_fd);
+
+        long long launch_start = monotonic_us();
+        pid_t pid = launch(server_fd, client_fd, &tracker);
+        if (pid < 0) log_error("process creation failed", 0);
+        else child_tracker_started(&tracker, pid, monotonic_us() - launch_start);
+        close(client_fd);
+    }
+    child_tracker_report(&tracker, stderr);
+    child_tracker_destroy(&tracker);
+    return 0;
+}
+
+static int run_fork(int server_fd, const struct server_config *config) {
+    return run_children(server_fd, config, launch_fork);
+}
+
+static int run_spawn(int server_fd, const struct server_config *config) {
+    if (spawn_setup(config) < 0) log_error(SPAWN_HANDLER_NAME " not found next to the server binary", 1);
+    // Keep the listening socket out of the handlers.
+    fcntl(server_fd, F_SETFD, FD_CLOEXEC);
+    return run_children(server_fd, config, launch_spawn);
+}
+
+const struct server_backend fork_backend = {
+    "fork", "fork() a child per connection, reaped through a signalfd", run_fork
+};
+
+const struct server_backend spawn_backend = {
+    "spawn", "posix_spawn() " SPAWN_HANDLER_NAME " per connection, fd passed as stdin", run_spawn
+};
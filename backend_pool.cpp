@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <pthread.h>
+
+#include "backends.h"
+#include "slow_writer.h"
+#include "hot_cache.h"
+
+#define POOL_QUEUE_SIZE 1024
+
+// Bounded ring of accepted fds; the acceptor blocks when it is full.
+struct fd_queue {
+    int fds[POOL_QUEUE_SIZE];
+    int head, count;
+    int closed;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty, not_full;
+};
+
+static struct fd_queue queue = {
+    {0}, 0, 0, 0, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER
+};
+
+static void queue_push(struct fd_queue *q, int fd) {
+    pthread_mutex_lock(&q->lock);
+    while (q->count == POOL_QUEUE_SIZE) pthread_cond_wait(&q->not_full, &q->lock);
+    q->fds[(q->head + q->count) % POOL_QUEUE_SIZE] = fd;
+    q->count++;
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+// Returns -1 once the queue is closed and drained.
+static int queue_pop(struct fd_queue *q) {
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0 && !q->closed) pthread_cond_wait(&q->not_empty, &q->lock);
+    int fd = -1;
+    if (q->count > 0) {
+        fd = q->fds[q->head];
+        q->head = (q->head + 1) % POOL_QUEUE_SIZE;
+        q->count--;
+        pthread_cond_signal(&q->not_full);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return fd;
+}
+
+static void queue_close(struct fd_queue *q) {
+    pthread_mutex_lock(&q->lock);
+    q->closed = 1;
+    pthread_cond_broadcast(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+static void *pool_worker(void *arg) {
+    struct fd_queue *q = (struct fd_queue *)arg;
+    int client_fd;
+    hot_cache_enable();
+    while ((client_fd = queue_pop(q)) >= 0) process_client_request(client_fd);
+    hot_cache_disable();
+    return NULL;
+}
+
+static int run_pool(int server_fd, const struct server_config *config) {
+    // Slow downloads move to the writer thread instead of holding a worker.
+    if (slow_writer_start() < 0) log_error("slow writer start failed", 0);
+    caches_start(server_fd);
+
+    int workers = worker_count(config);
+    pthread_t *tids = (pthread_t *)calloc(workers, sizeof(pthread_t));
+    if (!tids) log_error("calloc failed", 1);
+
+    for (int i = 0; i < workers; ++i) {
+        if (pthread_create(&tids[i], NULL, pool_worker, &queue) != 0)
+            log_error("pthread_create failed", 1);
+    }
+
+    struct sockaddr_storage client_addr;
+    socklen_t client_addr_len = sizeof(client_addr);
+
+    while (!shutdown_requested) {
+        int client_fd = accept_client(server_fd, (struct sockaddr *)&client_addr, &client_addr_len);
+        if (client_fd < 0) {
+            if (!shutdown_requested) log_error("accept failed", 0);
+            continue;
+        }
+        log_accept(config, client_fd);
+        queue_push(&queue, client_fd);
+    }
+
+    queue_close(&queue);
+    for (int i = 0; i < workers; ++i) pthread_join(tids[i], NULL);
+    free(tids);
+    return 0;
+}
+
+const struct server_backend pool_backend = {
+    "pool", "acceptor thread feeding N worker threads", run_pool
+};
@@ -0,0 +1,312 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <errno.h>
+
+#include "backends.h"
+#include "slow_writer.h"
+#include "response_headers.h"
+#include "hot_cache.h"
+
+#define RESPAWN_BACKOFF_MIN_MS 100
+#define RESPAWN_BACKOFF_MAX_MS 5000
+
+static void prefork_worker(int server_fd, const struct server_config *config) {
+    // Threads do not survive fork(); each worker runs its own Date timer,
+    // and its own writer thread so slow downloads do not hold the process.
+    date_cache_start();
+    if (slow_writer_start() < 0) log_error("slow writer start failed", 0);
+    caches_start(-1);
+    hot_cache_enable();
+
+    struct sockaddr_storage client_addr;
+    socklen_t client_addr_len = sizeof(client_addr);
+
+    while (!shutdown_requested) {
+        int client_fd = accept_client(server_fd, (struct sockaddr *)&client_addr, &client_addr_len);
+        if (client_fd < 0) {
+            if (!shutdown_requested && errno != EINTR) log_error("accept failed", 0);
+            continue;
+        }
+        log_accept(config, client_fd);
+        process_client_request(client_fd);
+    }
+    caches_stop();
+    exit(EXIT_SUCCESS);
+}
+
+static pid_t spawn_worker(int server_fd, const struct server_config *config) {
+    pid_t pid = fork();
+    if (pid < 0) log_error("fork failed", 0);
+    if (pid == 0) prefork_worker(server_fd, config);
+    return pid;
+}
+
+// Fork a worker into every empty slot (-1); returns how many still are.
+static int fill_slots(pid_t *pids, int workers, int server_fd, const struct server_config *config) {
+    int empty = 0;
+    for (int i = 0; i < workers && !shutdown_requested; ++i) {
+        if (pids[i] < 0) pids[i] = spawn_worker(server_fd, config);
+        empty += pids[i] < 0;
+    }
+    return empty;
+}
+
+// The parent only keeps the worker count up and forwards the shutdown.
+static int run_prefork(int server_fd, const struct server_config *config) {
+    int workers = worker_count(config);
+    pid_t *pids = (pid_t *)malloc(workers * sizeof(pid_t));
+    if (!pids) log_error("malloc failed", 1);
+    for (int i = 0; i < workers; ++i) pids[i] = -1;
+
+    // While fork() fails, retry the empty slots after a growing delay.
+    int backoff_ms = fill_slots(pids, workers, server_fd, config) ? RESPAWN_BACKOFF_MIN_MS : 0;
+    while (!shutdown_requested) {
+        int status;
+        pid_t pid = backoff_ms ? waitpid(-1, &status, WNOHANG) : wait(&status);
+        if (pid > 0) {
+            for (int i = 0; i < workers; ++i) {
+                if (pids[i] == pid) pids[i] = -1;
+            }
+        } else if (pid < 0 && errno == EINTR) {
+            continue;
+        } else if (!backoff_ms) {
+            break;
+        } else {
+            usleep(backoff_ms * 1000);
+        }
+        // The delay grows only with retries, not with other workers' exits.
+        if (fill_slots(pids, workers, server_fd, config) == 0)
+            backoff_ms = 0;
+        else if (!backoff_ms)
+            backoff_ms = RESPAWN_BACKOFF_MIN_MS;
+        else if (pid <= 0 && backoff_ms < RESPAWN_BACKOFF_MAX_MS)
+            backoff_ms = 2 * backoff_ms < RESPAWN_BACKOFF_MAX_MS ? 2 * backoff_ms : RESPAWN_BACKOFF_MAX_MS;
+    }
+
+    for (int i = 0; i < workers; ++i) {
+        if (pids[i] > 0) kill(pids[i], SIGTERM);
+    }
+    while (wait(NULL) > 0 || errno == EINTR) {}
+    free(pids);
+    return 0;
+}
+
+/*
+ * Dispatch mode: the parent accepts and hands each connection to the
+ * worker with the fewest connections in flight, over a per-worker unix
+ * socketpair with SCM_RIGHTS. Only the parent waits on the listening
+ * socket, so there is no herd to wake and no worker gets more than its
+ * share. The parent counts what it sent to each worker; the worker counts
+ * what it finished in a shared mapping, and the difference is the load.
+ * A connection handed to the slow writer counts once the writer closes it.
+ */
+
+// One cache line per worker, so workers do not false-share the counters.
+struct worker_load {
+    unsigned long completed;
+    char pad[64 - sizeof(unsigned long)];
+};
+
+struct dispatch_worker {
+    pid_t pid;
+    int channel;                // parent end of the socketpair, -1 when down
+    unsigned long dispatched;
+};
+
+// Receive one fd; returns -1 to retry and -2 once the parent has gone.
+static int receive_fd(int channel) {
+    char byte;
+    struct iovec iov = { &byte, 1 };
+    char control[CMSG_SPACE(sizeof(int))];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t n = recvmsg(channel, &msg, MSG_CMSG_CLOEXEC);
+    if (n == 0) return -2;
+    if (n < 0) return errno == EINTR ? -1 : -2;
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) return -1;
+    int fd;
+    memcpy(&fd, CMSG_DATA(cmsg), sizeof(fd));
+    return fd;
+}
+
+static int send_fd(int channel, int fd) {
+    char byte = 0;
+    struct iovec iov = { &byte, 1 };
+    char control[CMSG_SPACE(sizeof(int))];
+    memset(control, 0, sizeof(control));
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(fd));
+    // Never block the parent on a stuck worker; the caller tries the next one.
+    return sendmsg(channel, &msg, MSG_DONTWAIT | MSG_NOSIGNAL) == 1 ? 0 : -1;
+}
+
+static struct worker_load *own_load;      // this worker's, in a dispatch worker
+
+static void count_completed(void) {
+    __atomic_fetch_add(&own_load->completed, 1, __ATOMIC_RELEASE);
+}
+
+static void dispatch_worker_loop(int channel, struct worker_load *load) {
+    own_load = load;
+    slow_writer_set_done_hook(count_completed);
+    date_cache_start();
+    if (slow_writer_start() < 0) log_error("slow writer start failed", 0);
+    caches_start(-1);
+    hot_cache_enable();
+
+    while (!shutdown_requested) {
+        int client_fd = receive_fd(channel);
+        if (client_fd == -2) break;
+        if (client_fd < 0) continue;
+        if (process_client_request(client_fd) == 0) count_completed();
+    }
+    caches_stop();
+    exit(EXIT_SUCCESS);
+}
+
+static void start_dispatch_worker(struct dispatch_worker *w, struct worker_load *load,
+                                  int server_fd, struct dispatch_worker *all, int count) {
+    int pair[2];
+    w->pid = -1;
+    w->channel = -1;
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, pair) < 0) {
+        log_error("socketpair failed", 0);
+        return;
+    }
+    w->dispatched = 0;
+    __atomic_store_n(&load->completed, 0, __ATOMIC_RELAXED);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        log_error("fork failed", 0);
+        close(pair[0]);
+        close(pair[1]);
+        return;
+    }
+    if (pid == 0) {
+        close(server_fd);
+        for (int i = 0; i < count; ++i) {
+            if (all[i].channel >= 0) close(all[i].channel);
+        }
+        close(pair[0]);
+        install_shutdown_handler(-1);
+        dispatch_worker_loop(pair[1], load);
+    }
+    close(pair[1]);
+    w->pid = pid;
+    w->channel = pair[0];
+}
+
+// Least connections in flight; ties go round-robin from 'start'.
+static int pick_worker(struct dispatch_worker *workers, struct worker_load *loads, int count,
+                       int start, const int *skip) {
+    int best = -1;
+    unsigned long best_load = 0;
+    for (int k = 0; k < count; ++k) {
+        int i = (start + k) % count;
+        if (workers[i].channel < 0 || skip[i]) continue;
+        unsigned long load = workers[i].dispatched - __atomic_load_n(&loads[i].completed, __ATOMIC_ACQUIRE);
+        if (best < 0 || load < best_load) {
+            best = i;
+            best_load = load;
+        }
+    }
+    return best;
+}
+
+static void reap_dispatch_workers(struct dispatch_worker *workers, struct worker_load *loads, int count,
+                                  int server_fd) {
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        for (int i = 0; i < count; ++i) {
+            if (workers[i].pid != pid) continue;
+            if (workers[i].channel >= 0) close(workers[i].channel);
+            workers[i].channel = -1;
+            if (!shutdown_requested) start_dispatch_worker(&workers[i], &loads[i], server_fd, workers, count);
+        }
+    }
+}
+
+static int run_dispatch(int server_fd, const struct server_config *config) {
+    int count = worker_count(config);
+    struct dispatch_worker *workers = (struct dispatch_worker *)calloc(count, sizeof(*workers));
+    int *skip = (int *)calloc(count, sizeof(int));
+    struct worker_load *loads = (struct worker_load *)mmap(NULL, count * sizeof(struct worker_load),
+                                                           PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (!workers || !skip || loads == MAP_FAILED) log_error("dispatch setup failed", 1);
+    for (int i = 0; i < count; ++i) workers[i].channel = -1;
+    for (int i = 0; i < count; ++i) start_dispatch_worker(&workers[i], &loads[i], server_fd, workers, count);
+
+    struct sockaddr_storage client_addr;
+    socklen_t client_addr_len = sizeof(client_addr);
+    int next = 0;
+
+    while (!shutdown_requested) {
+        // Wake at least once a second to replace workers that died.
+        struct pollfd pfd = { server_fd, POLLIN, 0 };
+        int ready = poll(&pfd, 1, 1000);
+        reap_dispatch_workers(workers, loads, count, server_fd);
+        if (ready <= 0 || shutdown_requested) continue;
+
+        int client_fd = accept4(server_fd, (struct sockaddr *)&client_addr, &client_addr_len, SOCK_CLOEXEC);
+        if (client_fd < 0) {
+            if (!shutdown_requested && errno != EINTR) log_error("accept failed", 0);
+            continue;
+        }
+        log_accept(config, client_fd);
+
+        memset(skip, 0, count * sizeof(int));
+        int i;
+        while ((i = pick_worker(workers, loads, count, next, skip)) >= 0) {
+            if (send_fd(workers[i].channel, client_fd) == 0) {
+                workers[i].dispatched++;
+                break;
+            }
+            skip[i] = 1;
+        }
+        if (i < 0) log_error("no worker could take the connection", 0);
+        next = (next + 1) % count;
+        close(client_fd);
+    }
+
+    for (int i = 0; i < count; ++i) {
+        if (workers[i].channel >= 0) close(workers[i].channel);
+        if (workers[i].pid > 0) kill(workers[i].pid, SIGTERM);
+    }
+    while (wait(NULL) > 0 || errno == EINTR) {}
+    munmap(loads, count * sizeof(struct worker_load));
+    free(skip);
+    free(workers);
+    return 0;
+}
+
+const struct server_backend prefork_backend = {
+    "prefork", "N worker processes sharing accept()", run_prefork
+};
+
+const struct server_backend dispatch_backend = {
+    "dispatch", "parent accepts, passes fds to the least-loaded of N workers", run_dispatch
+};
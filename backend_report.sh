@@ -0,0 +1,43 @@
+#!/bin/bash
+
+## Compare requests/s of every serverbench backend on the same request
+## handling code. Writes backend_report.txt. Needs ab.
+
+src=$(dirname "$(readlink -f "$0")")
+port=${port:-18480}
+REQUESTS=${REQUESTS:-20000}
+CONC=${CONC:-"1 8 32"}
+REPEAT=${REPEAT:-5}
+WORKERS=${WORKERS:-0}
+BACKENDS=${BACKENDS:-"fork spawn thread prefork dispatch pool epoll io_uring"}
+
+if ! command -v ab > /dev/null; then
+    echo "ERROR: ab (apache2-utils) is needed for the report."
+    exit 1
+fi
+
+cd "$src" || exit 1
+if [[ ! -x ./serverbench ]]; then
+    echo "ERROR: ./serverbench is missing, run 'make'."
+    exit 1
+fi
+head -c 10000 < /dev/urandom > big
+
+printf "%-9s %6s %12s %12s\n" "backend" "conc" "rps(mean)" "rps(std)" | tee backend_report.txt
+for backend in $BACKENDS; do
+    ./serverbench 127.0.0.1:$port $backend $WORKERS > /dev/null &
+    pid=$!
+    sleep 0.5
+    for c in $CONC; do
+	rm -f tmp.rps
+	for ((k=0;k<REPEAT;k++)); do
+	    ab -n $REQUESTS -c $c http://127.0.0.1:$port/big 2>/dev/null | awk '/Requests per second/ {print $4}' >> tmp.rps
+	done
+	awk -v b=$backend -v c=$c '{sum += $1; sumsq += $1^2}
+	    END {printf "%-9s %6d %12.1f %12.1f\n", b, c, sum/NR, sqrt((sumsq-sum^2/NR)/NR)}' tmp.rps | tee -a backend_report.txt
+    done
+    kill -TERM $pid
+    wait $pid
+    port=$((port + 1))
+done
+rm -f tmp.rps
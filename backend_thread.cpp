@@ -0,0 +1,44 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <pthread.h>
+
+#include "backends.h"
+
+// The fd travels in the argument pointer itself, so accept needs no malloc.
+static void *connection_thread(void *arg) {
+    int client_fd = (int)(intptr_t)arg;
+    pthread_detach(pthread_self());
+
+    process_client_request(client_fd);
+    return NULL;
+}
+
+static int run_thread(int server_fd, const struct server_config *config) {
+    caches_start(server_fd);
+    struct sockaddr_storage client_addr;
+    socklen_t client_addr_len = sizeof(client_addr);
+
+    while (!shutdown_requested) {
+        int client_fd = accept_client(server_fd, (struct sockaddr *)&client_addr, &client_addr_len);
+        if (client_fd < 0) {
+            if (!shutdown_requested) log_error("accept failed", 0);
+            continue;
+        }
+
+        log_accept(config, client_fd);
+
+        pthread_t tid;
+        if (pthread_create(&tid, NULL, connection_thread, (void *)(intptr_t)client_fd) != 0) {
+            log_error("pthread_create failed", 0);
+            close(client_fd);
+        }
+    }
+    return 0;
+}
+
+const struct server_backend thread_backend = {
+    "thread", "pthread per connection", run_thread
+};
@@ -0,0 +1,320 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <errno.h>
+
+#include "backends.h"
+#include "conn_slab.h"
+#include "hot_cache.h"
+#include "ebr.h"
+
+/*
+ * io_uring backend on the raw system calls (no liburing). Every thread has
+ * its own ring with one accept outstanding on the shared listening socket,
+ * and each connection has at most one recv or sendmsg in flight.
+ */
+
+#define URING_ENTRIES 256
+#define URING_TICK_MS 1000
+
+// user_data values that are not connections.
+#define URING_ACCEPT 0
+#define URING_TICK 1
+
+struct uring {
+    int fd;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    unsigned sq_entries;
+    unsigned to_submit;
+    void *sq_ring, *cq_ring;
+    size_t sq_ring_size, cq_ring_size, sqes_size;
+};
+
+// Connection plus the iovecs/msghdr that must stay valid until the send completes.
+struct uring_conn {
+    struct connection conn;
+    struct iovec iov[MAX_OUTPUT_IOV];
+    struct msghdr msg;
+};
+
+struct uring_worker {
+    int server_fd;
+    const struct server_config *config;
+};
+
+// Per-thread loop state; 'live' lists every open connection for the timeout scan.
+struct uring_loop_state {
+    struct uring ring;
+    struct connection *live;
+    struct conn_slab slab;
+    struct __kernel_timespec tick;
+};
+
+static int uring_setup(struct uring *r, unsigned entries) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    memset(r, 0, sizeof(*r));
+    r->fd = syscall(__NR_io_uring_setup, entries, &p);
+    if (r->fd < 0) return -1;
+
+    r->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (r->cq_ring_size > r->sq_ring_size) r->sq_ring_size = r->cq_ring_size;
+        r->cq_ring_size = r->sq_ring_size;
+    }
+    r->sq_ring = mmap(NULL, r->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_ring == MAP_FAILED) return -1;
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        r->cq_ring = r->sq_ring;
+    } else {
+        r->cq_ring = mmap(NULL, r->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          r->fd, IORING_OFF_CQ_RING);
+        if (r->cq_ring == MAP_FAILED) return -1;
+    }
+    r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = (struct io_uring_sqe *)mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE,
+                                          MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) return -1;
+
+    char *sq = (char *)r->sq_ring;
+    char *cq = (char *)r->cq_ring;
+    r->sq_head = (unsigned *)(sq + p.sq_off.head);
+    r->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    r->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)(sq + p.sq_off.array);
+    r->cq_head = (unsigned *)(cq + p.cq_off.head);
+    r->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    r->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    r->sq_entries = p.sq_entries;
+    return 0;
+}
+
+static void uring_teardown(struct uring *r) {
+    munmap(r->sqes, r->sqes_size);
+    if (r->cq_ring != r->sq_ring) munmap(r->cq_ring, r->cq_ring_size);
+    munmap(r->sq_ring, r->sq_ring_size);
+    close(r->fd);
+}
+
+static int uring_enter(struct uring *r, unsigned min_complete) {
+    int ret = syscall(__NR_io_uring_enter, r->fd, r->to_submit, min_complete,
+                      min_complete ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    if (ret >= 0) r->to_submit -= ret;
+    return ret;
+}
+
+static struct io_uring_sqe *uring_get_sqe(struct uring *r) {
+    unsigned tail = *r->sq_tail;
+    if (tail - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE) >= r->sq_entries) {
+        uring_enter(r, 0);
+        if (tail - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE) >= r->sq_entries) return NULL;
+    }
+    unsigned index = tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    r->sq_array[index] = index;
+    __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    r->to_submit++;
+    return sqe;
+}
+
+static int queue_accept(struct uring *r, int server_fd) {
+    struct io_uring_sqe *sqe = uring_get_sqe(r);
+    if (!sqe) return -1;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = server_fd;
+    sqe->user_data = URING_ACCEPT;
+    return 0;
+}
+
+static int queue_tick(struct uring *r, struct __kernel_timespec *ts) {
+    struct io_uring_sqe *sqe = uring_get_sqe(r);
+    if (!sqe) return -1;
+    ts->tv_sec = URING_TICK_MS / 1000;
+    ts->tv_nsec = (URING_TICK_MS % 1000) * 1000000L;
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = (unsigned long)ts;
+    sqe->len = 1;
+    sqe->user_data = URING_TICK;
+    return 0;
+}
+
+static void loop_add(struct uring_loop_state *loop, struct connection *c) {
+    c->prev = NULL;
+    c->next = loop->live;
+    if (loop->live) loop->live->prev = c;
+    loop->live = c;
+}
+
+static void loop_remove(struct uring_loop_state *loop, struct connection *c) {
+    if (c->prev) c->prev->next = c->next;
+    else loop->live = c->next;
+    if (c->next) c->next->prev = c->prev;
+}
+
+// A recv or send is always in flight; shutting the socket down makes it
+// complete with an error, and the completion closes the connection.
+static void shutdown_slow_connections(struct uring_loop_state *loop) {
+    long long now = monotonic_ms();
+    for (struct connection *c = loop->live; c; c = c->next) {
+        if (connection_too_slow(c, now)) {
+            set_abortive_close(c->fd);
+            shutdown(c->fd, SHUT_RDWR);
+        }
+    }
+}
+
+static int queue_recv(struct uring *r, struct uring_conn *uc) {
+    struct io_uring_sqe *sqe = uring_get_sqe(r);
+    if (!sqe) return -1;
+    size_t space;
+    char *buf = connection_recv_space(&uc->conn, &space);
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = uc->conn.fd;
+    sqe->addr = (unsigned long)buf;
+    sqe->len = space;
+    sqe->user_data = (unsigned long)uc;
+    return 0;
+}
+
+static int queue_send(struct uring *r, struct uring_conn *uc) {
+    struct io_uring_sqe *sqe = uring_get_sqe(r);
+    if (!sqe) return -1;
+    memset(&uc->msg, 0, sizeof(uc->msg));
+    uc->msg.msg_iov = uc->iov;
+    uc->msg.msg_iovlen = connection_output(&uc->conn, uc->iov, MAX_OUTPUT_IOV);
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = uc->conn.fd;
+    sqe->addr = (unsigned long)&uc->msg;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = (unsigned long)uc;
+    return 0;
+}
+
+// Queue the next operation for a connection, or close it when it is done.
+static void advance(struct uring_loop_state *loop, struct uring_conn *uc, int state) {
+    int queued = -1;
+    if (state == CONN_READING) queued = queue_recv(&loop->ring, uc);
+    else if (state == CONN_WRITING) {
+        // The send completes in a later batch.
+        connection_hold(&uc->conn);
+        queued = queue_send(&loop->ring, uc);
+    }
+    if (queued < 0) {
+        loop_remove(loop, &uc->conn);
+        connection_close(&uc->conn);
+        conn_slab_free(&loop->slab, uc);
+    }
+}
+
+static void handle_completion(struct uring_loop_state *loop, struct uring_worker *w, struct io_uring_cqe *cqe) {
+    struct uring *r = &loop->ring;
+    if (cqe->user_data == URING_TICK) {
+        shutdown_slow_connections(loop);
+        if (!shutdown_requested) queue_tick(r, &loop->tick);
+        return;
+    }
+    if (cqe->user_data == URING_ACCEPT) {
+        if (cqe->res >= 0) {
+            log_accept(w->config, cqe->res);
+            struct uring_conn *uc = (struct uring_conn *)conn_slab_alloc(&loop->slab);
+            if (uc) {
+                connection_init(&uc->conn, cqe->res);
+                uc->conn.sendfile_ok = 0;       // bodies go out as sendmsg from the window
+                loop_add(loop, &uc->conn);
+                advance(loop, uc, CONN_READING);
+            } else {
+                log_error("connection slab alloc failed", 0);
+                close(cqe->res);
+            }
+        }
+        if (!shutdown_requested) queue_accept(r, w->server_fd);
+        return;
+    }
+
+    struct uring_conn *uc = (struct uring_conn *)(unsigned long)cqe->user_data;
+    int state;
+    if (cqe->res <= 0 && !(cqe->res == -EAGAIN || cqe->res == -EINTR)) {
+        state = CONN_DONE;
+    } else if (uc->conn.state == CONN_READING) {
+        uc->conn.recv_attempts++;
+        state = cqe->res > 0 ? connection_received(&uc->conn, cqe->res) : CONN_READING;
+        if (state == CONN_READING && uc->conn.recv_attempts >= MAX_RECV_ATTEMPTS) state = CONN_DONE;
+    } else {
+        state = cqe->res > 0 ? connection_sent(&uc->conn, cqe->res) : CONN_WRITING;
+    }
+    advance(loop, uc, state);
+}
+
+static void *uring_loop(void *arg) {
+    struct uring_worker *w = (struct uring_worker *)arg;
+    struct uring_loop_state loop;
+    memset(&loop, 0, sizeof(loop));
+    conn_slab_init(&loop.slab, sizeof(struct uring_conn));
+    if (uring_setup(&loop.ring, URING_ENTRIES) < 0) {
+        log_error("io_uring setup failed", 0);
+        return NULL;
+    }
+    struct uring *ring = &loop.ring;
+    queue_accept(ring, w->server_fd);
+    queue_tick(ring, &loop.tick);
+    hot_cache_enable();
+
+    while (!shutdown_requested) {
+        if (uring_enter(ring, 1) < 0 && errno != EINTR && errno != EBUSY) {
+            log_error("io_uring_enter failed", 0);
+            break;
+        }
+        int in_section = ebr_enter() == 0;
+        unsigned head = *ring->cq_head;
+        while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+            struct io_uring_cqe cqe = ring->cqes[head & *ring->cq_mask];
+            __atomic_store_n(ring->cq_head, ++head, __ATOMIC_RELEASE);
+            handle_completion(&loop, w, &cqe);
+        }
+        if (in_section) ebr_exit();
+    }
+    uring_teardown(ring);
+    while (loop.live) {
+        struct connection *c = loop.live;
+        loop_remove(&loop, c);
+        connection_close(c);
+    }
+    hot_cache_disable();
+    conn_slab_destroy(&loop.slab);
+    return NULL;
+}
+
+static int run_uring(int server_fd, const struct server_config *config) {
+    caches_start(server_fd);
+    int workers = worker_count(config);
+    pthread_t *tids = (pthread_t *)calloc(workers, sizeof(pthread_t));
+    if (!tids) log_error("calloc failed", 1);
+    struct uring_worker worker = { server_fd, config };
+
+    for (int i = 0; i < workers; ++i) {
+        if (pthread_create(&tids[i], NULL, uring_loop, &worker) != 0)
+            log_error("pthread_create failed", 1);
+    }
+    for (int i = 0; i < workers; ++i) pthread_join(tids[i], NULL);
+    free(tids);
+    return 0;
+}
+
+const struct server_backend uring_backend = {
+    "io_uring", "N threads, each with its own io_uring", run_uring
+};
@@ -0,0 +1,29 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "backends.h"
+
+static const struct server_backend *const server_backends[] = {
+    &fork_backend,
+    &spawn_backend,
+    &thread_backend,
+    &prefork_backend,
+    &dispatch_backend,
+    &pool_backend,
+    &epoll_backend,
+    &uring_backend,
+};
+
+#define BACKEND_COUNT (sizeof(server_backends) / sizeof(server_backends[0]))
+
+const struct server_backend *find_backend(const char *name) {
+    for (size_t i = 0; i < BACKEND_COUNT; ++i) {
+        if (strcmp(server_backends[i]->name, name) == 0) return server_backends[i];
+    }
+    return NULL;
+}
+
+void list_backends(FILE *out) {
+    for (size_t i = 0; i < BACKEND_COUNT; ++i)
+        fprintf(out, "  %-8s %s\n", server_backends[i]->name, server_backends[i]->description);
+}
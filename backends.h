@@ -0,0 +1,23 @@
+#ifndef BACKENDS_H
+#define BACKENDS_H
+
+#include "server_core.h"
+
+#define SPAWN_HANDLER_NAME "serverhandler"
+
+/*
+ * Concurrency backends. Each takes the bound listening socket and serves
+ * connections until shutdown_requested is set; all of them use the
+ * connection handler in server_core.h for the requests themselves.
+ */
+
+extern const struct server_backend fork_backend;      // fork() per connection
+extern const struct server_backend spawn_backend;     // posix_spawn() of serverhandler per connection
+extern const struct server_backend thread_backend;    // pthread per connection
+extern const struct server_backend prefork_backend;   // N processes blocking in accept()
+extern const struct server_backend dispatch_backend;  // parent accepts, SCM_RIGHTS to N processes
+extern const struct server_backend pool_backend;      // acceptor + N threads on a queue
+extern const struct server_backend epoll_backend;     // N threads, each with its own epoll loop
+extern const struct server_backend uring_backend;     // N threads, each with its own io_uring
+
+#endif
@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string_view>
+#include <unordered_map>
+
+#include "flat_index.h"
+#include "file_cache.h"
+
+// Microbenchmark: path lookups in the flat index and in a
+// std::unordered_map keyed by string_view, from 10k to 10M entries, in
+// random order. "flat" uses the hash computed while parsing, as the server
+// does; "flat+hash" also hashes the path, like the map has to. The speedup
+// is the map against "flat".
+
+#define LOOKUPS 2000000
+#define KEY_STRIDE 40
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static unsigned int hash_of(const char *s, size_t len) {
+    unsigned int h = FILE_CACHE_HASH_SEED;
+    for (size_t i = 0; i < len; ++i) h = file_cache_hash_step(h, s[i]);
+    return h;
+}
+
+static void run(size_t n) {
+    char *keys = (char *)malloc(n * KEY_STRIDE);
+    unsigned int *lens = (unsigned int *)malloc(n * sizeof(unsigned int));
+    unsigned int *hashes = (unsigned int *)malloc(n * sizeof(unsigned int));
+    struct index_key *items = (struct index_key *)malloc(n * sizeof(struct index_key));
+    size_t *order = (size_t *)malloc(LOOKUPS * sizeof(size_t));
+    if (!keys || !lens || !hashes || !items || !order) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < n; ++i) {
+        lens[i] = snprintf(keys + i * KEY_STRIDE, KEY_STRIDE, "static/d%05zu/asset-%zu.css", i % 10000, i);
+        hashes[i] = hash_of(keys + i * KEY_STRIDE, lens[i]);
+    }
+    unsigned long seed = 88172645463325252ul;
+    for (size_t i = 0; i < LOOKUPS; ++i) {
+        seed ^= seed << 13, seed ^= seed >> 7, seed ^= seed << 17;
+        order[i] = seed % n;
+    }
+
+    struct flat_index ix;
+    flat_index_init(&ix);
+    double t0 = now_ns();
+    for (size_t i = 0; i < n; ++i) {
+        if (index_key_intern(&ix, &items[i], keys + i * KEY_STRIDE, lens[i], hashes[i]) < 0 ||
+            flat_index_insert(&ix, &items[i]) < 0) {
+            perror("flat_index_insert");
+            exit(EXIT_FAILURE);
+        }
+    }
+    double insert_ns = (now_ns() - t0) / n;
+
+    size_t found = 0;
+    ebr_enter();
+    t0 = now_ns();
+    for (size_t i = 0; i < LOOKUPS; ++i) {
+        size_t k = order[i];
+        found += flat_index_find(&ix, keys + k * KEY_STRIDE, lens[k], hashes[k]) != NULL;
+    }
+    double flat_ns = (now_ns() - t0) / LOOKUPS;
+    t0 = now_ns();
+    for (size_t i = 0; i < LOOKUPS; ++i) {
+        const char *key = keys + order[i] * KEY_STRIDE;
+        size_t len = lens[order[i]];
+        found += flat_index_find(&ix, key, len, hash_of(key, len)) != NULL;
+    }
+    double hashed_ns = (now_ns() - t0) / LOOKUPS;
+    // Misses: an indexed key with its first letter changed, hashed here.
+    char miss[KEY_STRIDE];
+    t0 = now_ns();
+    for (size_t i = 0; i < LOOKUPS; ++i) {
+        size_t len = lens[order[i]];
+        memcpy(miss, keys + order[i] * KEY_STRIDE, len);
+        miss[0] = 'S';
+        found += flat_index_find(&ix, miss, len, hash_of(miss, len)) != NULL;
+    }
+    double miss_ns = (now_ns() - t0) / LOOKUPS;
+    ebr_exit();
+
+    std::unordered_map<std::string_view, struct index_key *> map;
+    map.reserve(n);
+    for (size_t i = 0; i < n; ++i) map.emplace(std::string_view(items[i].str, items[i].len), &items[i]);
+    t0 = now_ns();
+    for (size_t i = 0; i < LOOKUPS; ++i) {
+        size_t k = order[i];
+        found += map.find(std::string_view(keys + k * KEY_STRIDE, lens[k])) != map.end();
+    }
+    double map_ns = (now_ns() - t0) / LOOKUPS;
+
+    if (found != 3ul * LOOKUPS) {
+        fprintf(stderr, "%zu entries: %zu of %d lookups found\n", n, found, 3 * LOOKUPS);
+        exit(EXIT_FAILURE);
+    }
+    printf("%9zu  %7.1f  %6.1f  %9.1f  %6.1f  %13.1f  %6.2fx\n", n, insert_ns, flat_ns, hashed_ns, miss_ns,
+           map_ns, map_ns / flat_ns);
+
+    map.clear();
+    for (size_t i = 0; i < n; ++i) index_key_release(&items[i]);
+    flat_index_destroy(&ix);
+    free(keys);
+    free(lens);
+    free(hashes);
+    free(items);
+    free(order);
+}
+
+int main(void) {
+    printf("  entries   insert    flat  flat+hash    miss  unordered_map  speedup   (ns per op)\n");
+    for (size_t n = 10000; n <= 10000000; n *= 10) run(n);
+    return 0;
+}
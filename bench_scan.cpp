@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <ftw.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <string>
+#include <unordered_map>
+
+#include "docroot_index.h"
+#include "file_cache.h"
+#include "server_core.h"
+
+// Microbenchmark: startup indexing of a document root against its size.
+// "serial" is the file-by-file walk: readdir, stat() of the full path, MIME
+// type, into a std::unordered_map. The others are docroot_index_build() on
+// 1, 4 and 16 threads. Trees are leaf directories of LEAF_FILES empty
+// files, 16 leaves per directory. BENCH_SCAN_FILES=<n> adds an n-file tree,
+// e.g. 1000000.
+
+#define LEAF_FILES 64
+#define LEAVES_PER_DIR 16
+
+static const char *extensions[] = { ".css", ".js", ".html", ".png" };
+static const int thread_counts[] = { 1, 4, 16 };
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void make_tree(const char *root, size_t files) {
+    char path[512];
+    for (size_t i = 0; i < files; ++i) {
+        size_t leaf = i / LEAF_FILES;
+        if (i % LEAF_FILES == 0) {
+            snprintf(path, sizeof(path), "%s/d%zu", root, leaf / LEAVES_PER_DIR);
+            mkdir(path, 0700);
+            snprintf(path, sizeof(path), "%s/d%zu/e%zu", root, leaf / LEAVES_PER_DIR, leaf);
+            mkdir(path, 0700);
+        }
+        snprintf(path, sizeof(path), "%s/d%zu/e%zu/f%zu%s", root, leaf / LEAVES_PER_DIR, leaf, i, extensions[i % 4]);
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        if (fd < 0) {
+            perror("setup");
+            exit(EXIT_FAILURE);
+        }
+        close(fd);
+    }
+}
+
+static int remove_entry(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    (void)st, (void)type, (void)ftw;
+    return remove(path);
+}
+
+struct serial_file {
+    struct stat st;
+    const char *mime_type;
+};
+
+static void serial_walk(const std::string &dir, std::unordered_map<std::string, serial_file> &index) {
+    DIR *d = opendir(dir.c_str());
+    if (!d) return;
+    struct dirent *de;
+    while ((de = readdir(d))) {
+        if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, "..")) continue;
+        std::string path = dir + "/" + de->d_name;
+        struct serial_file f;
+        if (stat(path.c_str(), &f.st) < 0) continue;
+        if (S_ISDIR(f.st.st_mode)) {
+            serial_walk(path, index);
+        } else if (S_ISREG(f.st.st_mode)) {
+            f.mime_type = get_mime_type(path.c_str());
+            index.emplace(path, f);
+        }
+    }
+    closedir(d);
+}
+
+static void run(size_t files) {
+    char root[] = "/tmp/bench_scan.XXXXXX";
+    if (!mkdtemp(root)) {
+        perror("mkdtemp");
+        exit(EXIT_FAILURE);
+    }
+    make_tree(root, files);
+
+    double start = now_ms();
+    std::unordered_map<std::string, serial_file> map;
+    serial_walk(root, map);
+    double serial = now_ms() - start;
+    if (map.size() != files) fprintf(stderr, "serial: %zu of %zu files\n", map.size(), files);
+
+    double scan[3];
+    for (int i = 0; i < 3; ++i) {
+        struct docroot_index ix;
+        start = now_ms();
+        if (docroot_index_build(&ix, root, thread_counts[i]) < 0) {
+            perror("docroot_index_build");
+            exit(EXIT_FAILURE);
+        }
+        scan[i] = now_ms() - start;
+        if (ix.files != files) fprintf(stderr, "%d threads: %zu of %zu files\n", thread_counts[i], ix.files, files);
+        docroot_index_destroy(&ix);
+    }
+    printf("%9zu  %9.1f  %9.1f  %9.1f  %9.1f  %6.2fx\n", files, serial, scan[0], scan[1], scan[2], serial / scan[2]);
+    fflush(stdout);
+    nftw(root, remove_entry, 64, FTW_DEPTH | FTW_PHYS);
+}
+
+int main(void) {
+    printf("%9s  %9s  %9s  %9s  %9s  %7s   (ms; speedup is 16 threads vs serial)\n", "files", "serial", "1 thread",
+           "4 threads", "16 thr.", "speedup");
+    run(10000);
+    run(100000);
+    const char *extra = getenv("BENCH_SCAN_FILES");
+    if (extra && strtoul(extra, NULL, 10) > 0) run(strtoul(extra, NULL, 10));
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include <stdlib.h>
+
+#include "buffer_pool.h"
+
+// Free buffers are chained through their first bytes.
+struct free_buffer {
+    struct free_buffer *next;
+};
+
+struct buffer_list {
+    int lock;
+    int count;
+    struct free_buffer *head;
+};
+
+static const size_t class_sizes[BUFFER_CLASSES] = { 1024, 4096, 16384, 65536 };
+static struct buffer_list free_lists[BUFFER_CLASSES];
+
+static void list_lock(struct buffer_list *l) {
+    while (__atomic_test_and_set(&l->lock, __ATOMIC_ACQUIRE)) {}
+}
+
+static void list_unlock(struct buffer_list *l) {
+    __atomic_clear(&l->lock, __ATOMIC_RELEASE);
+}
+
+int buffer_class_for(size_t size) {
+    for (int cls = 0; cls < BUFFER_CLASSES; ++cls) {
+        if (class_sizes[cls] >= size) return cls;
+    }
+    return -1;
+}
+
+size_t buffer_class_size(int cls) {
+    return class_sizes[cls];
+}
+
+char *buffer_get(int cls) {
+    struct buffer_list *l = &free_lists[cls];
+    list_lock(l);
+    struct free_buffer *b = l->head;
+    if (b) {
+        l->head = b->next;
+        l->count--;
+    }
+    list_unlock(l);
+    if (b) return (char *)b;
+    return (char *)malloc(class_sizes[cls]);
+}
+
+void buffer_put(char *buf, int cls) {
+    if (!buf) return;
+    struct buffer_list *l = &free_lists[cls];
+    struct free_buffer *b = (struct free_buffer *)buf;
+    list_lock(l);
+    if (l->count < BUFFER_POOL_MAX_FREE) {
+        b->next = l->head;
+        l->head = b;
+        l->count++;
+        b = NULL;
+    }
+    list_unlock(l);
+    free(b);
+}
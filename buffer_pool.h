@@ -0,0 +1,23 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <stddef.h>
+
+/*
+ * Pooled I/O buffers in a few fixed size classes (1, 4, 16 and 64 KiB).
+ * Freed buffers go onto a per-class free list and are handed out again
+ * without touching malloc; each list keeps at most BUFFER_POOL_MAX_FREE
+ * buffers, beyond that they are freed.
+ */
+
+#define BUFFER_CLASSES 4
+#define BUFFER_POOL_MAX_FREE 4096
+
+// Smallest class holding at least size bytes, or -1 if none does.
+int buffer_class_for(size_t size);
+size_t buffer_class_size(int cls);
+
+char *buffer_get(int cls);
+void buffer_put(char *buf, int cls);
+
+#endif
@@ -0,0 +1,47 @@
+#!/bin/bash
+
+## Compare requests/s of the default, -O3, LTO and PGO builds of both servers.
+## Run via 'make report', which builds all variants first. Writes
+## build_report.txt.
+
+src=$(dirname "$(readlink -f "$0")")
+port=${port:-18380}
+REQUESTS=${REQUESTS:-20000}
+CONC=${CONC:-8}
+REPEAT=${REPEAT:-5}
+
+if ! command -v ab > /dev/null; then
+    echo "ERROR: ab (apache2-utils) is needed for the report."
+    exit 1
+fi
+
+cd "$src" || exit 1
+head -c 10000 < /dev/urandom > big
+
+printf "%-8s %-14s %12s %12s\n" "build" "server" "rps(mean)" "rps(std)" | tee build_report.txt
+for variant in default o3 lto pgo; do
+    if [[ "$variant" == "default" ]]; then
+	dir=.
+    else
+	dir=build/$variant
+    fi
+    for bin in serverfork serverthread; do
+	if [[ ! -x "$dir/$bin" ]]; then
+	    echo "ERROR: $dir/$bin is missing, run 'make variants'."
+	    exit 1
+	fi
+	"$dir/$bin" 127.0.0.1:$port > /dev/null &
+	pid=$!
+	sleep 0.5
+	rm -f tmp.rps
+	for ((k=0;k<REPEAT;k++)); do
+	    ab -n $REQUESTS -c $CONC http://127.0.0.1:$port/big 2>/dev/null | awk '/Requests per second/ {print $4}' >> tmp.rps
+	done
+	kill -TERM $pid
+	wait $pid
+	awk -v b=$variant -v s=$bin '{sum += $1; sumsq += $1^2}
+	    END {printf "%-8s %-14s %12.1f %12.1f\n", b, s, sum/NR, sqrt((sumsq-sum^2/NR)/NR)}' tmp.rps | tee -a build_report.txt
+	port=$((port + 1))
+    done
+done
+rm -f tmp.rps
@@ -0,0 +1,167 @@
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/signalfd.h>
+#include <sys/wait.h>
+
+#include "child_tracker.h"
+#include "server_core.h"
+
+static void tracker_sigset(sigset_t *set) {
+    sigemptyset(set);
+    sigaddset(set, SIGCHLD);
+    sigaddset(set, CHILD_STATS_SIGNAL);
+}
+
+int child_tracker_init(struct child_tracker *t, int max_children) {
+    memset(t, 0, sizeof(*t));
+    t->max_children = max_children > 0 ? max_children : DEFAULT_MAX_CHILDREN;
+
+    // Twice the cap, rounded up to a power of two, keeps probe chains short.
+    int size = 16;
+    while (size < 2 * t->max_children) size <<= 1;
+    t->slots = (struct child_slot *)calloc(size, sizeof(struct child_slot));
+    if (!t->slots) return -1;
+    t->slot_mask = size - 1;
+
+    sigset_t set;
+    tracker_sigset(&set);
+    if (sigprocmask(SIG_BLOCK, &set, NULL) < 0) return -1;
+    t->fd = signalfd(-1, &set, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (t->fd < 0) return -1;
+    t->report_at_us = monotonic_us();
+    return 0;
+}
+
+static void histogram_add(struct child_histogram *h, long long us) {
+    if (us < 0) us = 0;
+    int b = 0;
+    while (b < CHILD_HIST_BUCKETS - 1 && (1LL << (b + 1)) <= us) b++;
+    h->count[b]++;
+    h->total++;
+    if ((unsigned long long)us > h->max_us) h->max_us = us;
+}
+
+// Upper bound of the bucket holding the given fraction of samples.
+static unsigned long long histogram_percentile(const struct child_histogram *h, double p) {
+    if (h->total == 0) return 0;
+    unsigned long long want = (unsigned long long)(p * h->total), seen = 0;
+    for (int b = 0; b < CHILD_HIST_BUCKETS; ++b) {
+        seen += h->count[b];
+        if (seen > want) {
+            unsigned long long bound = 1ULL << (b + 1);
+            return bound < h->max_us ? bound : h->max_us;
+        }
+    }
+    return h->max_us;
+}
+
+void child_tracker_started(struct child_tracker *t, pid_t pid, long long fork_us) {
+    int i = pid & t->slot_mask;
+    while (t->slots[i].pid != 0) i = (i + 1) & t->slot_mask;
+    t->slots[i].pid = pid;
+    t->slots[i].start_us = monotonic_us() - fork_us;
+    t->forks++;
+    if (++t->live > t->peak) t->peak = t->live;
+    histogram_add(&t->fork_time, fork_us);
+}
+
+// Remove pid from the table and return its start time, or -1 if unknown.
+// Later entries of the probe chain shift back into the hole.
+static long long take_slot(struct child_tracker *t, pid_t pid) {
+    int i = pid & t->slot_mask;
+    while (t->slots[i].pid != pid) {
+        if (t->slots[i].pid == 0) return -1;
+        i = (i + 1) & t->slot_mask;
+    }
+    long long start = t->slots[i].start_us;
+    int hole = i;
+    for (int j = (i + 1) & t->slot_mask; t->slots[j].pid != 0; j = (j + 1) & t->slot_mask) {
+        int home = t->slots[j].pid & t->slot_mask;
+        // Move j into the hole unless its home lies cyclically in (hole, j].
+        if (((j - home) & t->slot_mask) >= ((j - hole) & t->slot_mask)) {
+            t->slots[hole] = t->slots[j];
+            hole = j;
+        }
+    }
+    t->slots[hole].pid = 0;
+    return start;
+}
+
+static void reap_children(struct child_tracker *t) {
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        long long start = take_slot(t, pid);
+        if (start < 0) continue;
+        t->live--;
+        histogram_add(&t->lifetime, monotonic_us() - start);
+        if (WIFSIGNALED(status)) t->killed++;
+        else if (WEXITSTATUS(status) == EXIT_SUCCESS) t->exited_ok++;
+        else t->exited_error++;
+    }
+}
+
+void child_tracker_poll(struct child_tracker *t) {
+    struct signalfd_siginfo info;
+    int reap = 0, report = 0;
+    while (read(t->fd, &info, sizeof(info)) == sizeof(info)) {
+        if (info.ssi_signo == SIGCHLD) reap = 1;
+        else if (info.ssi_signo == CHILD_STATS_SIGNAL) report = 1;
+    }
+    if (reap) reap_children(t);
+    if (report) child_tracker_report(t, stderr);
+}
+
+int child_tracker_full(struct child_tracker *t) {
+    if (t->live < t->max_children) {
+        t->stalled = 0;
+        return 0;
+    }
+    if (!t->stalled) {
+        t->stalled = 1;
+        t->capped++;
+        long long now = monotonic_ms();
+        if (now - t->cap_logged_ms >= CHILD_CAP_LOG_INTERVAL_MS) {
+            fprintf(stderr, "fork cap of %d children reached, pausing accept\n", t->max_children);
+            t->cap_logged_ms = now;
+        }
+    }
+    return 1;
+}
+
+void child_tracker_child_setup(struct child_tracker *t) {
+    close(t->fd);
+    sigset_t set;
+    tracker_sigset(&set);
+    sigprocmask(SIG_UNBLOCK, &set, NULL);
+}
+
+// The fork rate covers the time since the previous report.
+void child_tracker_report(struct child_tracker *t, FILE *out) {
+    long long now = monotonic_us();
+    double seconds = (now - t->report_at_us) / 1e6;
+    double rate = seconds > 0 ? (t->forks - t->report_forks) / seconds : 0;
+    t->report_at_us = now;
+    t->report_forks = t->forks;
+
+    fprintf(out, "children: forks=%llu rate=%.1f/s live=%d peak=%d cap=%d capped=%llu "
+            "exit_ok=%llu exit_error=%llu killed=%llu\n",
+            t->forks, rate, t->live, t->peak, t->max_children, t->capped,
+            t->exited_ok, t->exited_error, t->killed);
+    fprintf(out, "children: fork_us p50=%llu p90=%llu p99=%llu max=%llu\n",
+            histogram_percentile(&t->fork_time, 0.50), histogram_percentile(&t->fork_time, 0.90),
+            histogram_percentile(&t->fork_time, 0.99), t->fork_time.max_us);
+    fprintf(out, "children: lifetime_us p50=%llu p90=%llu p99=%llu max=%llu\n",
+            histogram_percentile(&t->lifetime, 0.50), histogram_percentile(&t->lifetime, 0.90),
+            histogram_percentile(&t->lifetime, 0.99), t->lifetime.max_us);
+    fflush(out);
+}
+
+void child_tracker_destroy(struct child_tracker *t) {
+    close(t->fd);
+    free(t->slots);
+    t->slots = NULL;
+}
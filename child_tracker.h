@@ -0,0 +1,68 @@
+#ifndef CHILD_TRACKER_H
+#define CHILD_TRACKER_H
+
+#include <stdio.h>
+#include <sys/types.h>
+
+/*
+ * Accounting for per-connection child processes.
+ *
+ * The parent blocks SIGCHLD and CHILD_STATS_SIGNAL and reads them from a
+ * signalfd, which it polls next to the listening socket. Every fork is
+ * recorded with its start time in a pid table. On SIGCHLD all exited
+ * children are reaped with waitpid(WNOHANG), since signals coalesce, and
+ * their lifetime and exit status are recorded. At max_children live
+ * children the caller stops accepting until one exits, so a fork storm
+ * queues in the listen backlog instead of exhausting the process table.
+ *
+ * CHILD_STATS_SIGNAL, and shutdown, write the fork count and rate, live
+ * and peak children, exit statuses and the fork() call time and child
+ * lifetime percentiles to stderr.
+ */
+
+#define CHILD_STATS_SIGNAL SIGUSR1
+#define DEFAULT_MAX_CHILDREN 256
+#define CHILD_HIST_BUCKETS 32       // log2 buckets of microseconds
+#define CHILD_CAP_LOG_INTERVAL_MS 10000
+
+struct child_slot {
+    pid_t pid;                      // 0 = empty
+    long long start_us;
+};
+
+struct child_histogram {
+    unsigned long long count[CHILD_HIST_BUCKETS];
+    unsigned long long total, max_us;
+};
+
+struct child_tracker {
+    int fd;                         // signalfd
+    int max_children;
+    struct child_slot *slots;       // open addressing on pid
+    int slot_mask;
+    int live, peak;
+    int stalled;                    // at max_children since the last check
+    unsigned long long forks, exited_ok, exited_error, killed, capped;
+    long long report_at_us;         // start of the current fork rate window
+    unsigned long long report_forks;
+    long long cap_logged_ms;
+    struct child_histogram fork_time, lifetime;
+};
+
+// Block the tracker's signals and open the signalfd; max_children 0 means
+// DEFAULT_MAX_CHILDREN. Returns -1 on failure.
+int child_tracker_init(struct child_tracker *t, int max_children);
+// Record a forked child and how long fork() took.
+void child_tracker_started(struct child_tracker *t, pid_t pid, long long fork_us);
+// Call when the signalfd is readable: reaps exited children and answers
+// CHILD_STATS_SIGNAL.
+void child_tracker_poll(struct child_tracker *t);
+// True when another child would exceed max_children; each stretch of
+// being full counts once in 'capped'.
+int child_tracker_full(struct child_tracker *t);
+// In a new child: close the signalfd and unblock the signals again.
+void child_tracker_child_setup(struct child_tracker *t);
+void child_tracker_report(struct child_tracker *t, FILE *out);
+void child_tracker_destroy(struct child_tracker *t);
+
+#endif
@@ -0,0 +1,100 @@
+#include <stdlib.h>
+#include <sys/resource.h>
+
+#include "conn_slab.h"
+
+// Objects are carved after a header word that links the chunks together.
+struct slab_chunk {
+    struct slab_chunk *next;
+};
+
+struct free_object {
+    struct free_object *next;
+};
+
+static void **conn_table;
+static int conn_table_size;
+
+void conn_slab_init(struct conn_slab *s, size_t object_size) {
+    // Keep every object aligned for the structs stored in it.
+    s->object_size = (object_size + 15) & ~(size_t)15;
+    s->free_list = NULL;
+    s->chunks = NULL;
+    s->live = s->capacity = 0;
+}
+
+#ifndef NO_CONN_SLAB
+static int conn_slab_grow(struct conn_slab *s) {
+    size_t header = (sizeof(struct slab_chunk) + 15) & ~(size_t)15;
+    char *chunk = (char *)malloc(header + s->object_size * CONN_SLAB_CHUNK);
+    if (!chunk) return -1;
+    ((struct slab_chunk *)chunk)->next = (struct slab_chunk *)s->chunks;
+    s->chunks = chunk;
+
+    char *objects = chunk + header;
+    for (int i = CONN_SLAB_CHUNK - 1; i >= 0; --i) {
+        struct free_object *o = (struct free_object *)(objects + i * s->object_size);
+        o->next = (struct free_object *)s->free_list;
+        s->free_list = o;
+    }
+    s->capacity += CONN_SLAB_CHUNK;
+    return 0;
+}
+#endif
+
+void *conn_slab_alloc(struct conn_slab *s) {
+#ifdef NO_CONN_SLAB
+    s->live++;
+    return malloc(s->object_size);
+#else
+    if (!s->free_list && conn_slab_grow(s) < 0) return NULL;
+    struct free_object *o = (struct free_object *)s->free_list;
+    s->free_list = o->next;
+    s->live++;
+    return o;
+#endif
+}
+
+void conn_slab_free(struct conn_slab *s, void *obj) {
+    if (!obj) return;
+    s->live--;
+#ifdef NO_CONN_SLAB
+    free(obj);
+#else
+    struct free_object *o = (struct free_object *)obj;
+    o->next = (struct free_object *)s->free_list;
+    s->free_list = o;
+#endif
+}
+
+void conn_slab_destroy(struct conn_slab *s) {
+    struct slab_chunk *chunk = (struct slab_chunk *)s->chunks;
+    while (chunk) {
+        struct slab_chunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    s->chunks = s->free_list = NULL;
+    s->capacity = 0;
+}
+
+int conn_table_init(void) {
+    struct rlimit rl;
+    if (conn_table) return 0;
+    if (getrlimit(RLIMIT_NOFILE, &rl) < 0 || rl.rlim_cur == RLIM_INFINITY || rl.rlim_cur > (1 << 24))
+        rl.rlim_cur = 1 << 16;
+    conn_table = (void **)calloc(rl.rlim_cur, sizeof(void *));
+    if (!conn_table) return -1;
+    conn_table_size = rl.rlim_cur;
+    return 0;
+}
+
+int conn_table_set(int fd, void *obj) {
+    if (fd < 0 || fd >= conn_table_size) return -1;
+    conn_table[fd] = obj;
+    return 0;
+}
+
+void *conn_table_get(int fd) {
+    return fd >= 0 && fd < conn_table_size ? conn_table[fd] : NULL;
+}
@@ -0,0 +1,40 @@
+#ifndef CONN_SLAB_H
+#define CONN_SLAB_H
+
+#include <stddef.h>
+
+/*
+ * Slab of fixed-size connection objects with an intrusive free list.
+ *
+ * Each event-loop thread owns one slab, so allocation and release are a
+ * pointer pop/push with no locks and no malloc: memory is only taken, in
+ * chunks of CONN_SLAB_CHUNK objects, while the slab is still growing to
+ * the peak number of open connections. Build with -DNO_CONN_SLAB to fall
+ * back to malloc/free per object (for comparisons, see alloc_report.sh).
+ *
+ * The connection table maps an fd to the object serving it, so event
+ * loops can carry just the fd in their events.
+ */
+
+#define CONN_SLAB_CHUNK 256
+
+struct conn_slab {
+    size_t object_size;
+    void *free_list;
+    void *chunks;           // chained through the first word of each chunk
+    size_t live, capacity;
+};
+
+void conn_slab_init(struct conn_slab *s, size_t object_size);
+void *conn_slab_alloc(struct conn_slab *s);
+void conn_slab_free(struct conn_slab *s, void *obj);
+// Release every chunk; all objects must have been freed.
+void conn_slab_destroy(struct conn_slab *s);
+
+// Size the fd table from RLIMIT_NOFILE. Call once before serving.
+int conn_table_init(void);
+// Returns -1 for an fd beyond the table.
+int conn_table_set(int fd, void *obj);
+void *conn_table_get(int fd);
+
+#endif
@@ -0,0 +1,177 @@
+#include <string.h>
+
+#include "content_hash.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define LANES 8
+#define PRIME32_1 0x9e3779b1ull
+#define PRIME64_1 0x9e3779b185ebca87ull
+#define PRIME_MIX 0x165667919e3779f9ull
+
+// Stripe s of a block uses secret[s .. s + 7]; the tail stripe uses
+// secret[16 .. 23], the scramble secret[8 .. 15] and the merge secret[3 .. 10].
+static const uint64_t secret[24] = {
+    0x103c320ad88b7ed5ull, 0x33228c5f7c496816ull, 0x7b1a60bb6bdead58ull,
+    0x96931e980650c659ull, 0x6aa2a056e9a25892ull, 0x597977263253c44bull,
+    0x026e3947cf4e1ac6ull, 0x7fbb51347a674fcdull, 0x7aed4fb16053a0d4ull,
+    0x39484981c5a3e49cull, 0xc9f6e45d9428920aull, 0x281b4bda9b365669ull,
+    0x4f5131c1f9c95127ull, 0xfe7d88a5015e49ebull, 0x6afcbc69bcd73479ull,
+    0x754c19daee0c0f27ull, 0xd333638105ca138dull, 0xc72bc698cfcd0eefull,
+    0x51758a19875a9aa6ull, 0x6422dd9b647f36a9ull, 0x3f5cfdb9d09c5c60ull,
+    0x3c741610de41af01ull, 0x7779f797c98abf02ull, 0x884d5e637ae1b6bbull,
+};
+
+static inline uint64_t read64(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static void accumulate_scalar(uint64_t *acc, const unsigned char *stripe, const uint64_t *key) {
+    for (int i = 0; i < LANES; ++i) {
+        uint64_t data = read64(stripe + i * 8);
+        uint64_t mixed = data ^ key[i];
+        acc[i ^ 1] += data;
+        acc[i] += (mixed & 0xffffffffull) * (mixed >> 32);
+    }
+}
+
+static void scramble_scalar(uint64_t *acc, const uint64_t *key) {
+    for (int i = 0; i < LANES; ++i) {
+        uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= key[i];
+        acc[i] = a * PRIME32_1;
+    }
+}
+
+#ifdef __SSE2__
+static void accumulate_sse2(__m128i *acc, const unsigned char *stripe, const uint64_t *key) {
+    for (int i = 0; i < LANES / 2; ++i) {
+        __m128i data = _mm_loadu_si128((const __m128i *)(stripe + i * 16));
+        __m128i mixed = _mm_xor_si128(data, _mm_loadu_si128((const __m128i *)(key + i * 2)));
+        __m128i high = _mm_shuffle_epi32(mixed, _MM_SHUFFLE(0, 3, 0, 1));
+        __m128i product = _mm_mul_epu32(mixed, high);
+        __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+        acc[i] = _mm_add_epi64(acc[i], _mm_add_epi64(product, swapped));
+    }
+}
+
+static void scramble_sse2(__m128i *acc, const uint64_t *key) {
+    const __m128i prime = _mm_set1_epi32((int)PRIME32_1);
+    for (int i = 0; i < LANES / 2; ++i) {
+        __m128i a = acc[i];
+        a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+        a = _mm_xor_si128(a, _mm_loadu_si128((const __m128i *)(key + i * 2)));
+        // 64x32 multiply: low half, plus the high half's product shifted up.
+        __m128i low = _mm_mul_epu32(a, prime);
+        __m128i high = _mm_mul_epu32(_mm_srli_epi64(a, 32), prime);
+        acc[i] = _mm_add_epi64(low, _mm_slli_epi64(high, 32));
+    }
+}
+#endif
+
+static inline uint64_t fold_mul(uint64_t a, uint64_t b) {
+    __uint128_t product = (__uint128_t)a * b;
+    return (uint64_t)product ^ (uint64_t)(product >> 64);
+}
+
+// Take in stripes, the first of which is stripe number first of the input.
+static void consume(uint64_t *acc, const unsigned char *p, size_t stripes, uint64_t first, int simd) {
+#ifdef __SSE2__
+    if (simd) {
+        __m128i lanes[LANES / 2];
+        memcpy(lanes, acc, sizeof(lanes));
+        for (size_t i = 0; i < stripes; ++i) {
+            size_t s = (first + i) % CONTENT_HASH_BLOCK;
+            accumulate_sse2(lanes, p + i * CONTENT_HASH_STRIPE, secret + s);
+            if (s == CONTENT_HASH_BLOCK - 1) scramble_sse2(lanes, secret + 8);
+        }
+        memcpy(acc, lanes, sizeof(lanes));
+        return;
+    }
+#endif
+    (void)simd;
+    for (size_t i = 0; i < stripes; ++i) {
+        size_t s = (first + i) % CONTENT_HASH_BLOCK;
+        accumulate_scalar(acc, p + i * CONTENT_HASH_STRIPE, secret + s);
+        if (s == CONTENT_HASH_BLOCK - 1) scramble_scalar(acc, secret + 8);
+    }
+}
+
+static void update(struct content_hasher *h, const void *data, size_t len, int simd) {
+    const unsigned char *p = (const unsigned char *)data;
+    size_t stripes = len / CONTENT_HASH_STRIPE, rest = len % CONTENT_HASH_STRIPE;
+    consume(h->acc, p, stripes, h->len / CONTENT_HASH_STRIPE, simd);
+    if (stripes) memcpy(h->tail, p + (stripes - 1) * CONTENT_HASH_STRIPE, CONTENT_HASH_STRIPE);
+    if (rest) {
+        // The tail stripe: the input's last 64 bytes, zero-padded when it is shorter.
+        size_t keep = h->len + len >= CONTENT_HASH_STRIPE ? CONTENT_HASH_STRIPE - rest : 0;
+        if (keep)
+            memmove(h->tail, h->tail + rest, keep);
+        else
+            memset(h->tail, 0, CONTENT_HASH_STRIPE);
+        memcpy(h->tail + keep, p + stripes * CONTENT_HASH_STRIPE, rest);
+        h->has_tail = 1;
+    }
+    h->len += len;
+}
+
+static uint64_t final(struct content_hasher *h, int simd) {
+    if (h->len == 0) {
+        memset(h->tail, 0, CONTENT_HASH_STRIPE);
+        h->has_tail = 1;
+    }
+    // The tail stripe goes in out of block order, with its own part of the secret.
+    if (h->has_tail) {
+#ifdef __SSE2__
+        if (simd) {
+            __m128i lanes[LANES / 2];
+            memcpy(lanes, h->acc, sizeof(lanes));
+            accumulate_sse2(lanes, h->tail, secret + 16);
+            memcpy(h->acc, lanes, sizeof(lanes));
+        } else
+#endif
+            accumulate_scalar(h->acc, h->tail, secret + 16);
+    }
+    (void)simd;
+    uint64_t r = h->len * PRIME64_1;
+    for (int i = 0; i < LANES; i += 2) r += fold_mul(h->acc[i] ^ secret[3 + i], h->acc[i + 1] ^ secret[4 + i]);
+    r ^= r >> 37;
+    r *= PRIME_MIX;
+    return r ^ (r >> 32);
+}
+
+void content_hash_init(struct content_hasher *h) {
+    static const uint64_t acc_init[LANES] = {
+        PRIME32_1, PRIME64_1, secret[0], secret[1], secret[2], PRIME_MIX, secret[22], secret[23],
+    };
+    memcpy(h->acc, acc_init, sizeof(h->acc));
+    h->len = 0;
+    h->has_tail = 0;
+}
+
+void content_hash_update(struct content_hasher *h, const void *data, size_t len) {
+    update(h, data, len, 1);
+}
+
+uint64_t content_hash_final(struct content_hasher *h) {
+    return final(h, 1);
+}
+
+uint64_t content_hash(const void *data, size_t len) {
+    struct content_hasher h;
+    content_hash_init(&h);
+    update(&h, data, len, 1);
+    return final(&h, 1);
+}
+
+uint64_t content_hash_scalar(const void *data, size_t len) {
+    struct content_hasher h;
+    content_hash_init(&h);
+    update(&h, data, len, 0);
+    return final(&h, 0);
+}
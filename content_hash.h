@@ -0,0 +1,45 @@
+#ifndef CONTENT_HASH_H
+#define CONTENT_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Fast non-cryptographic 64-bit hash of file contents, for strong ETags.
+ *
+ * It is built like XXH3 for long inputs. Eight 64-bit lanes take in the
+ * input one CONTENT_HASH_STRIPE at a time. Each lane adds two things: the
+ * product of the 32-bit halves of (data ^ secret), and its neighbour's
+ * data. The secret moves by one lane per stripe, so stripe order matters
+ * within a block. Every CONTENT_HASH_BLOCK stripes the lanes are scrambled.
+ * The last, partial stripe is taken from the input's final 64 bytes, or
+ * zero-padded when the input is shorter. The length goes into the final
+ * mix.
+ *
+ * With SSE2, one instruction works on two lanes (_mm_mul_epu32 for the
+ * products). The scalar path computes the same values, so a file gets the
+ * same ETag on every host whatever it was built for. The secret and tail
+ * are simpler than XXH3's, so the values are not xxhsum's.
+ */
+
+#define CONTENT_HASH_STRIPE 64
+#define CONTENT_HASH_BLOCK 16       // stripes between scrambles
+
+struct content_hasher {
+    uint64_t acc[8];
+    uint64_t len;                   // bytes taken so far
+    int has_tail;
+    unsigned char tail[CONTENT_HASH_STRIPE];    // the last stripe seen, then the tail stripe
+};
+
+// Incremental form, for files read in chunks.
+void content_hash_init(struct content_hasher *h);
+// len must be a multiple of CONTENT_HASH_STRIPE, except in the last call.
+void content_hash_update(struct content_hasher *h, const void *data, size_t len);
+uint64_t content_hash_final(struct content_hasher *h);
+
+uint64_t content_hash(const void *data, size_t len);
+// The portable path, for comparison in benchmarks.
+uint64_t content_hash_scalar(const void *data, size_t len);
+
+#endif
@@ -6,3 +6,18 @@ set style data linespoints
 
 plot "statistics_fork.log" using 1:3 title 'Average Forked' with linespoints,  "statistics_fork.log" using 1:4 title 'std.dev (Fork)' with linespoints, \
    "statistics_thread.log" using 1:3 title 'Average Thread' with linespoints, "statistics_thread.log" using 1:4 title 'std.dev (Thread)' with linespoints
+
+## latency_*.log columns: concurrency p50 p90 p99 max cpu_us_per_req peak_rss_kb
+set output 'latency.png'
+set ylabel 'Latency (ms)'
+plot "latency_fork.log" using 1:2 title 'p50 (Fork)', "latency_fork.log" using 1:3 title 'p90 (Fork)', \
+   "latency_fork.log" using 1:4 title 'p99 (Fork)', "latency_fork.log" using 1:5 title 'max (Fork)', \
+   "latency_thread.log" using 1:2 title 'p50 (Thread)', "latency_thread.log" using 1:3 title 'p90 (Thread)', \
+   "latency_thread.log" using 1:4 title 'p99 (Thread)', "latency_thread.log" using 1:5 title 'max (Thread)'
+
+set output 'cpu.png'
+set ylabel 'Server CPU time per request (us)'
+set y2label 'Peak RSS (kB)'
+set y2tics
+plot "latency_fork.log" using 1:6 title 'CPU/req (Fork)', "latency_thread.log" using 1:6 title 'CPU/req (Thread)', \
+   "latency_fork.log" using 1:7 axes x1y2 title 'Peak RSS (Fork)', "latency_thread.log" using 1:7 axes x1y2 title 'Peak RSS (Thread)'
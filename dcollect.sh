@@ -4,6 +4,11 @@
 portFORK=8282
 portTHREAD=8283
 testing=1
+## Server PIDs, leave empty to look them up from the listening port.
+pidFORK=
+pidTHREAD=
+
+CLK_TCK=$(getconf CLK_TCK)
 
 head -c 10000 < /dev/urandom > big
 head -c 1000 < /dev/urandom > small 
@@ -24,6 +29,85 @@ fi
 ## Clean up statistics files
 rm -rf statistics_fork.log
 rm -rf statistics_thread.log
+rm -rf latency_fork.log
+rm -rf latency_thread.log
+
+## Find the pid of the process listening on port $1.
+server_pid() {
+    ss -Hltnp "sport = :$1" 2>/dev/null | grep -o 'pid=[0-9]*' | head -1 | cut -d= -f2
+}
+
+## Print $1 and all of its (live) descendants.
+proc_tree() {
+    echo "$1"
+    local c
+    for c in $(cat /proc/$1/task/*/children 2>/dev/null); do
+	proc_tree "$c"
+    done
+}
+
+## CPU ticks used by $1 and its children. utime+stime of every live process
+## in the tree, plus cutime+cstime of the root for children already reaped
+## (the fork backend waits for each child, so every one is counted there).
+cpu_ticks() {
+    local total=0 p f
+    for p in $(proc_tree "$1"); do
+	f=$(sed 's/^.*) //' /proc/$p/stat 2>/dev/null) || continue
+	total=$(echo "$f" | awk -v t=$total -v root=$([[ "$p" == "$1" ]] && echo 1 || echo 0) \
+	    '{t += $12 + $13; if (root) t += $14 + $15; print t}')
+    done
+    echo "$total"
+}
+
+## Resident set size (kB) summed over $1 and its descendants.
+rss_kb() {
+    local total=0 p r
+    for p in $(proc_tree "$1"); do
+	r=$(awk '/^VmRSS:/ {print $2}' /proc/$p/status 2>/dev/null)
+	total=$((total + ${r:-0}))
+    done
+    echo "$total"
+}
+
+## Sample rss_kb of $1 until killed, writing the peak to $2.
+rss_sampler() {
+    local peak=0 r
+    while true; do
+	r=$(rss_kb "$1")
+	if (( r > peak )); then
+	    peak=$r
+	    echo "$peak" > "$2"
+	fi
+	sleep 0.05
+    done
+}
+
+## Run one ab measurement against port $1 (server pid $2) at concurrency $3.
+## Prints "rps p50 p90 p99 max cpu_us_per_req peak_rss_kb".
+measure() {
+    local port=$1 pid=$2 conc=$3 nreq=10000 out cpu0 cpu1 sampler
+    echo 0 > tmp.rss
+    rss_sampler "$pid" tmp.rss &
+    sampler=$!
+    cpu0=$(cpu_ticks "$pid")
+    out=$(ab -n $nreq -c $conc http://127.0.0.1:$port/big 2>/dev/null)
+    cpu1=$(cpu_ticks "$pid")
+    kill $sampler 2>/dev/null
+    wait $sampler 2>/dev/null
+    echo "$out" | awk -v dcpu=$((cpu1 - cpu0)) -v hz=$CLK_TCK -v n=$nreq -v rss=$(cat tmp.rss) '
+	/Requests per second/ {rps = $4}
+	/^  50%/ {p50 = $2}
+	/^  90%/ {p90 = $2}
+	/^  99%/ {p99 = $2}
+	/^ 100%/ {pmax = $2}
+	END {if (rps != "") printf "%s %s %s %s %s %f %d\n", rps, p50, p90, p99, pmax, dcpu / hz / n * 1e6, rss}'
+}
+
+## Column means of file $1, on one line.
+column_means() {
+    awk '{for(i=1;i<=NF;i++) sum[i] += $i}
+         END {for (i=1;i<=NF;i++) printf "%f ", sum[i]/NR; printf "\n"}' "$1"
+}
 
 echo "Concurrency = $CONCURRENCY, REPETITONS = $REPEAT."
 
@@ -102,20 +186,27 @@ echo ""
 echo "*** Performance forked server."
 echo " "
 
+pidFORK=${pidFORK:-$(server_pid $portFORK)}
+if [[ -z "$pidFORK" ]]; then
+    echo "ERROR: Could not find the pid of the forked server, set pidFORK."
+    exit 1
+fi
+
 
 ## Remove any performance data files.
-rm -rf perf_*.txt
+rm -rf perf_*.txt lat_*.txt
 for ((i=1;i<CONCURRENCY;i++)); do
     for ((k=1;k<REPEAT;k++)); do
-	bonkers=$(ab -n 10000 -c $i http://127.0.0.1:$portFORK/big 2>/dev/null | grep 'Requests per second');
-	value=$(echo "$bonkers" | awk '{print $4}');
-	echo "C=$i,$k => $value";
+	sample=$(measure $portFORK $pidFORK $i);
+	value=$(echo "$sample" | awk '{print $1}');
+	echo "C=$i,$k => $sample";
 	if [[ -z "$value" ]]; then
 	    echo "ERROR: No usefull data was collected from AB, this is an serious ISSUE."
 	    echo "ERROR: Check server on http://127.0.0.1:$portFORK/big "
 	    exit 1
 	fi
 	echo "$value" >> "perf_$i.txt" ;
+	echo "$sample" | cut -d' ' -f2- >> "lat_$i.txt" ;
     done;
     echo "Done all repetitions for $i, doing statistics (with awk). "
     statistics=$(awk '{for(i=1;i<=NF;i++) {sum[i] += $i; sumsq[i] += ($i)^2}} 
@@ -123,25 +214,33 @@ for ((i=1;i<CONCURRENCY;i++)); do
           printf "%f %f \n", sum[i]/NR, sqrt((sumsq[i]-sum[i]^2/NR)/NR)}
          }' perf_$i.txt)
     echo "$i => $statistics " | tee -a statistics_fork.log
+    echo "$i $(column_means lat_$i.txt)" | tee -a latency_fork.log
 done
 
 
 echo "*** Performance threaded server."
 echo " "
 
+pidTHREAD=${pidTHREAD:-$(server_pid $portTHREAD)}
+if [[ -z "$pidTHREAD" ]]; then
+    echo "ERROR: Could not find the pid of the threaded server, set pidTHREAD."
+    exit 1
+fi
+
 ## Remove any performance data files. 
-rm -rf perf_*.txt
+rm -rf perf_*.txt lat_*.txt
 for ((i=1;i<CONCURRENCY;i++)); do
     for ((k=1;k<REPEAT;k++)); do
-	bonkers=$(ab -n 10000 -c $i http://127.0.0.1:$portTHREAD/big 2>/dev/null | grep 'Requests per second');
-	value=$(echo "$bonkers" | awk '{print $4}');
-	echo "C=$i,$k => $value";
+	sample=$(measure $portTHREAD $pidTHREAD $i);
+	value=$(echo "$sample" | awk '{print $1}');
+	echo "C=$i,$k => $sample";
 	if [[ -z "$value" ]]; then
 	    echo "ERROR: No usefull data was collected from AB, this is an serious ISSUE."
 	    echo "ERROR: Check server on http://127.0.0.1:$portTHREAD/big "
 	    exit 1
 	fi
 	echo "$value" >> "perf_$i.txt" ;
+	echo "$sample" | cut -d' ' -f2- >> "lat_$i.txt" ;
     done;
     echo "Done all repetitions for $i, doing statistics (with awk). "
     statistics=$(awk '{for(i=1;i<=NF;i++) {sum[i] += $i; sumsq[i] += ($i)^2}} 
@@ -149,6 +248,7 @@ for ((i=1;i<CONCURRENCY;i++)); do
           printf "%f %f \n", sum[i]/NR, sqrt((sumsq[i]-sum[i]^2/NR)/NR)}
          }' perf_$i.txt)
     echo "$i => $statistics " | tee -a statistics_thread.log
+    echo "$i $(column_means lat_$i.txt)" | tee -a latency_thread.log
 done
 
 
@@ -0,0 +1,41 @@
+#!/bin/bash
+
+## Compare tail latency of shared-accept prefork workers with the parent
+## dispatching fds to the least-loaded worker ('serverfork <addr> dispatch').
+## Reports requests/s and the p50/p90/p99/max latency from ab at each
+## concurrency level. Writes dispatch_report.txt.
+
+src=$(dirname "$(readlink -f "$0")")
+port=${port:-18880}
+REQUESTS=${REQUESTS:-20000}
+CONC=${CONC:-"8 32 128"}
+MODES=${MODES:-"prefork dispatch"}
+
+if ! command -v ab > /dev/null; then
+    echo "ERROR: ab (apache2-utils) is needed for the report."
+    exit 1
+fi
+
+cd "$src" || exit 1
+if [[ ! -x ./serverfork ]]; then
+    echo "ERROR: ./serverfork is missing, run 'make'."
+    exit 1
+fi
+head -c 10000 < /dev/urandom > big
+
+printf "%-9s %6s %12s %8s %8s %8s %8s\n" "mode" "conc" "rps" "p50_ms" "p90_ms" "p99_ms" "max_ms" | tee dispatch_report.txt
+for mode in $MODES; do
+    ./serverfork 127.0.0.1:$port $mode > /dev/null &
+    pid=$!
+    sleep 0.5
+    for c in $CONC; do
+	ab -n $REQUESTS -c $c http://127.0.0.1:$port/big 2>/dev/null |
+	    awk -v m=$mode -v c=$c '/Requests per second/ {rps = $4}
+		$1 == "50%" {p50 = $2} $1 == "90%" {p90 = $2} $1 == "99%" {p99 = $2} $1 == "100%" {max = $2}
+		END {printf "%-9s %6d %12.1f %8d %8d %8d %8d\n", m, c, rps, p50, p90, p99, max}' |
+	    tee -a dispatch_report.txt
+    done
+    kill -TERM $pid
+    wait $pid
+    port=$((port + 1))
+done
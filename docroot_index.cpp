@@ -0,0 +1,341 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "docroot_index.h"
+#include "file_cache.h"
+#include "server_core.h"
+
+#define DOCROOT_IDLE_US 50
+
+// getdents64(2) record.
+struct linux_dirent64 {
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+struct dir_job {
+    size_t len;
+    char path[];                // from the root, "" for the root itself
+};
+
+struct job_deque {
+    pthread_mutex_t lock;
+    struct dir_job **jobs;
+    size_t head, tail, cap;
+};
+
+struct docroot_chunk {
+    struct docroot_chunk *next;
+    size_t used;
+    struct docroot_file files[DOCROOT_ENTRY_CHUNK];
+};
+
+struct walk {
+    struct docroot_index *ix;
+    int root_fd;
+    int threads;
+    struct job_deque *deques;
+    size_t pending;             // directories queued or being read
+};
+
+struct walker {
+    struct walk *walk;
+    int self;
+    pthread_t tid;
+    struct docroot_chunk *chunk;
+    size_t files, dirs, errors;
+};
+
+static struct docroot_index *server_index;
+
+static int push_back(struct job_deque *d, struct dir_job *job) {
+    pthread_mutex_lock(&d->lock);
+    if (d->tail == d->cap) {
+        if (d->head > 0) {
+            memmove(d->jobs, d->jobs + d->head, (d->tail - d->head) * sizeof(struct dir_job *));
+            d->tail -= d->head;
+            d->head = 0;
+        } else {
+            size_t cap = d->cap ? d->cap * 2 : 64;
+            struct dir_job **jobs = (struct dir_job **)realloc(d->jobs, cap * sizeof(struct dir_job *));
+            if (!jobs) {
+                pthread_mutex_unlock(&d->lock);
+                return -1;
+            }
+            d->jobs = jobs;
+            d->cap = cap;
+        }
+    }
+    d->jobs[d->tail++] = job;
+    pthread_mutex_unlock(&d->lock);
+    return 0;
+}
+
+static struct dir_job *pop_back(struct job_deque *d) {
+    pthread_mutex_lock(&d->lock);
+    struct dir_job *job = d->tail > d->head ? d->jobs[--d->tail] : NULL;
+    pthread_mutex_unlock(&d->lock);
+    return job;
+}
+
+static struct dir_job *steal_front(struct job_deque *d) {
+    pthread_mutex_lock(&d->lock);
+    struct dir_job *job = d->tail > d->head ? d->jobs[d->head++] : NULL;
+    pthread_mutex_unlock(&d->lock);
+    return job;
+}
+
+static void queue_dir(struct walker *w, const char *path, size_t len) {
+    struct dir_job *job = (struct dir_job *)malloc(sizeof(struct dir_job) + len + 1);
+    if (!job) {
+        w->errors++;
+        return;
+    }
+    job->len = len;
+    memcpy(job->path, path, len + 1);
+    __atomic_add_fetch(&w->walk->pending, 1, __ATOMIC_RELAXED);
+    if (push_back(&w->walk->deques[w->self], job) < 0) {
+        __atomic_sub_fetch(&w->walk->pending, 1, __ATOMIC_RELEASE);
+        free(job);
+        w->errors++;
+    }
+}
+
+static void add_file(struct walker *w, const char *path, size_t len, const struct statx *stx) {
+    struct docroot_index *ix = w->walk->ix;
+    if (!w->chunk || w->chunk->used == DOCROOT_ENTRY_CHUNK) {
+        struct docroot_chunk *chunk = (struct docroot_chunk *)malloc(sizeof(struct docroot_chunk));
+        if (!chunk) {
+            w->errors++;
+            return;
+        }
+        chunk->used = 0;
+        pthread_mutex_lock(&ix->chunks_lock);
+        chunk->next = ix->chunks;
+        ix->chunks = chunk;
+        pthread_mutex_unlock(&ix->chunks_lock);
+        w->chunk = chunk;
+    }
+    struct docroot_file *f = &w->chunk->files[w->chunk->used];
+    unsigned int hash = file_cache_hash(path);
+    f->mime_type = get_mime_type(path);
+    f->size = stx->stx_size;
+    f->mtime_ns = stx->stx_mtime.tv_sec * 1000000000LL + stx->stx_mtime.tv_nsec;
+    f->ino = stx->stx_ino;
+
+    struct docroot_shard *s = &ix->shards[hash % DOCROOT_SHARDS];
+    pthread_mutex_lock(&s->lock);
+    int ok = index_key_intern(&s->index, &f->key, path, len, hash) == 0;
+    if (ok && flat_index_insert(&s->index, &f->key) < 0) {
+        index_key_release(&f->key);
+        ok = 0;
+    }
+    pthread_mutex_unlock(&s->lock);
+    if (ok) {
+        w->chunk->used++;
+        w->files++;
+    } else {
+        w->errors++;
+    }
+}
+
+static void read_dir(struct walker *w, const struct dir_job *job, char *buf) {
+    int fd = openat(w->walk->root_fd, job->len ? job->path : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        w->errors++;
+        return;
+    }
+    w->dirs++;
+    char path[KEY_MAX_LEN + 1];
+    memcpy(path, job->path, job->len);
+    if (job->len) path[job->len] = '/';
+    size_t prefix = job->len ? job->len + 1 : 0;
+
+    long n;
+    while ((n = syscall(SYS_getdents64, fd, buf, DOCROOT_DIR_BUFFER)) > 0) {
+        for (long off = 0; off < n;) {
+            struct linux_dirent64 *d = (struct linux_dirent64 *)(buf + off);
+            off += d->d_reclen;
+            const char *name = d->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+            if (d->d_type != DT_DIR && d->d_type != DT_REG && d->d_type != DT_LNK && d->d_type != DT_UNKNOWN)
+                continue;
+            size_t name_len = strlen(name);
+            if (prefix + name_len > KEY_MAX_LEN) {
+                w->errors++;
+                continue;
+            }
+            memcpy(path + prefix, name, name_len + 1);
+            size_t len = prefix + name_len;
+            if (d->d_type == DT_DIR) {
+                queue_dir(w, path, len);
+                continue;
+            }
+            // Only a symlink is followed, and only to a file.
+            struct statx stx;
+            int link = d->d_type == DT_LNK;
+            int flags = AT_STATX_DONT_SYNC | (link ? 0 : AT_SYMLINK_NOFOLLOW);
+            unsigned int mask = STATX_TYPE | STATX_SIZE | STATX_MTIME | STATX_INO;
+            int ret = statx(fd, name, flags, mask, &stx);
+            // Without d_type the entry may turn out to be a link after all.
+            if (ret == 0 && S_ISLNK(stx.stx_mode)) {
+                link = 1;
+                ret = statx(fd, name, AT_STATX_DONT_SYNC, mask, &stx);
+            }
+            if (ret < 0) {
+                w->errors++;
+                continue;
+            }
+            if (S_ISREG(stx.stx_mode))
+                add_file(w, path, len, &stx);
+            else if (S_ISDIR(stx.stx_mode) && !link)
+                queue_dir(w, path, len);
+        }
+    }
+    if (n < 0) w->errors++;
+    close(fd);
+}
+
+static void *walk_thread(void *arg) {
+    struct walker *w = (struct walker *)arg;
+    struct walk *walk = w->walk;
+    char *buf = (char *)malloc(DOCROOT_DIR_BUFFER);
+    if (!buf) return NULL;
+    while (1) {
+        struct dir_job *job = pop_back(&walk->deques[w->self]);
+        for (int i = 1; !job && i < walk->threads; ++i)
+            job = steal_front(&walk->deques[(w->self + i) % walk->threads]);
+        if (!job) {
+            if (__atomic_load_n(&walk->pending, __ATOMIC_ACQUIRE) == 0) break;
+            usleep(DOCROOT_IDLE_US);
+            continue;
+        }
+        read_dir(w, job, buf);
+        free(job);
+        __atomic_sub_fetch(&walk->pending, 1, __ATOMIC_RELEASE);
+    }
+    free(buf);
+    return NULL;
+}
+
+int docroot_index_build(struct docroot_index *ix, const char *root, int threads) {
+    memset(ix, 0, sizeof(*ix));
+    pthread_mutex_init(&ix->chunks_lock, NULL);
+    for (int i = 0; i < DOCROOT_SHARDS; ++i) {
+        pthread_mutex_init(&ix->shards[i].lock, NULL);
+        flat_index_init(&ix->shards[i].index);
+    }
+    if (threads < 1) threads = 1;
+
+    long long start = monotonic_ms();
+    struct walk walk;
+    walk.ix = ix;
+    walk.threads = threads;
+    walk.pending = 0;
+    walk.root_fd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (walk.root_fd < 0) return -1;
+    walk.deques = (struct job_deque *)calloc(threads, sizeof(struct job_deque));
+    struct walker *walkers = (struct walker *)calloc(threads, sizeof(struct walker));
+    if (!walk.deques || !walkers) {
+        free(walk.deques);
+        free(walkers);
+        close(walk.root_fd);
+        return -1;
+    }
+    for (int i = 0; i < threads; ++i) {
+        pthread_mutex_init(&walk.deques[i].lock, NULL);
+        walkers[i].walk = &walk;
+        walkers[i].self = i;
+    }
+    queue_dir(&walkers[0], "", 0);
+
+    int started = 0;
+    for (; started < threads; ++started)
+        if (pthread_create(&walkers[started].tid, NULL, walk_thread, &walkers[started]) != 0) break;
+    // Threads that did not start have empty deques, which the others skip.
+    if (started == 0) free(pop_back(&walk.deques[0]));
+    for (int i = 0; i < started; ++i) {
+        pthread_join(walkers[i].tid, NULL);
+        ix->files += walkers[i].files;
+        ix->dirs += walkers[i].dirs;
+        ix->errors += walkers[i].errors;
+    }
+    for (int i = 0; i < threads; ++i) {
+        free(walk.deques[i].jobs);
+        pthread_mutex_destroy(&walk.deques[i].lock);
+    }
+    free(walk.deques);
+    free(walkers);
+    close(walk.root_fd);
+    ix->threads = started;
+    ix->scan_ms = monotonic_ms() - start;
+    return started > 0 ? 0 : -1;
+}
+
+void docroot_index_destroy(struct docroot_index *ix) {
+    for (int i = 0; i < DOCROOT_SHARDS; ++i) {
+        flat_index_destroy(&ix->shards[i].index);
+        pthread_mutex_destroy(&ix->shards[i].lock);
+    }
+    struct docroot_chunk *chunk = ix->chunks;
+    while (chunk) {
+        struct docroot_chunk *next = chunk->next;
+        for (size_t i = 0; i < chunk->used; ++i) index_key_release(&chunk->files[i].key);
+        free(chunk);
+        chunk = next;
+    }
+    ix->chunks = NULL;
+    pthread_mutex_destroy(&ix->chunks_lock);
+}
+
+const struct docroot_file *docroot_index_find(struct docroot_index *ix, const char *path, size_t len,
+                                              unsigned int hash) {
+    return (const struct docroot_file *)flat_index_find(&ix->shards[hash % DOCROOT_SHARDS].index, path, len, hash);
+}
+
+int docroot_scan(int threads) {
+    if (__atomic_load_n(&server_index, __ATOMIC_ACQUIRE)) return 0;
+    struct docroot_index *ix = (struct docroot_index *)malloc(sizeof(*ix));
+    if (!ix) return -1;
+    if (docroot_index_build(ix, ".", threads) < 0) {
+        docroot_index_destroy(ix);
+        free(ix);
+        return -1;
+    }
+    fprintf(stderr, "[%d] docroot scan: files=%zu dirs=%zu errors=%zu threads=%d ms=%lld\n", (int)getpid(),
+            ix->files, ix->dirs, ix->errors, ix->threads, ix->scan_ms);
+    docroot_install(ix);
+    return 0;
+}
+
+static void reclaim_index(struct ebr_node *node) {
+    struct docroot_index *ix = (struct docroot_index *)((char *)node - offsetof(struct docroot_index, retired));
+    docroot_index_destroy(ix);
+    free(ix);
+}
+
+void docroot_install(struct docroot_index *ix) {
+    struct docroot_index *old = __atomic_exchange_n(&server_index, ix, __ATOMIC_ACQ_REL);
+    if (old) ebr_retire(&old->retired, reclaim_index);
+}
+
+const char *docroot_mime_type(const char *path, size_t len, unsigned int hash) {
+    // The MIME types are static strings, so they outlive the section.
+    int own_section = !ebr_active();
+    if (own_section && ebr_enter() < 0) return get_mime_type(path);
+    struct docroot_index *ix = __atomic_load_n(&server_index, __ATOMIC_ACQUIRE);
+    const struct docroot_file *f = ix ? docroot_index_find(ix, path, len, hash) : NULL;
+    const char *type = f ? f->mime_type : get_mime_type(path);
+    if (own_section) ebr_exit();
+    return type;
+}
@@ -0,0 +1,78 @@
+#ifndef DOCROOT_INDEX_H
+#define DOCROOT_INDEX_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "flat_index.h"
+
+/*
+ * Index of every regular file under the document root, built at startup.
+ *
+ * The tree is walked by several threads. Each thread has a deque of
+ * directories still to read. It pops from the back of its own deque, so
+ * it goes depth first while the subtree is warm. A thread with an empty
+ * deque steals from the front of another's, where the oldest and usually
+ * largest subtrees wait. A directory is read in DOCROOT_DIR_BUFFER batches
+ * with getdents64. Each entry is then checked with statx() relative to the
+ * directory's fd, with no path lookup from the root and no forced sync.
+ * The entry's d_type saves the call for subdirectories. Symlinks are
+ * followed to files but not to directories, so the walk cannot loop.
+ *
+ * Each file is indexed by its path relative to the root, which is the form
+ * requests use, with its size, mtime, inode and MIME type. There are
+ * DOCROOT_SHARDS flat_index shards (flat_index.h), each with a writer lock.
+ * The hash is the file cache's, so a request's hash finds it. An index is
+ * complete before anyone reads it and never changes afterwards. Files
+ * added later are simply not in it. The server's index is replaced whole
+ * when the document root switches to a new release (docroot_switch.h), so
+ * its lookups run in an EBR section and the old index is retired.
+ */
+
+#define DOCROOT_SHARDS 16
+#define DOCROOT_DIR_BUFFER (64 * 1024)
+#define DOCROOT_ENTRY_CHUNK 1024
+
+struct docroot_file {
+    struct index_key key;       // path from the root; first, so the index's pointer is the entry's
+    const char *mime_type;
+    off_t size;
+    long long mtime_ns;
+    ino_t ino;
+};
+
+struct docroot_chunk;
+
+struct docroot_shard {
+    pthread_mutex_t lock;
+    struct flat_index index;
+};
+
+struct docroot_index {
+    struct docroot_shard shards[DOCROOT_SHARDS];
+    struct docroot_chunk *chunks;       // every entry, for destroy
+    pthread_mutex_t chunks_lock;
+    size_t files, dirs, errors;
+    int threads;
+    long long scan_ms;
+    struct ebr_node retired;
+};
+
+// Walk root on threads threads (at least 1) into ix. -1 when root cannot
+// be opened or no thread could start.
+int docroot_index_build(struct docroot_index *ix, const char *root, int threads);
+void docroot_index_destroy(struct docroot_index *ix);
+// Entry for path (len bytes, hashed with file_cache_hash), or NULL.
+const struct docroot_file *docroot_index_find(struct docroot_index *ix, const char *path, size_t len,
+                                              unsigned int hash);
+
+// The server's index of its working directory: build it once before
+// serving, then look up MIME types, falling back to get_mime_type() for
+// files it does not know.
+int docroot_scan(int threads);
+const char *docroot_mime_type(const char *path, size_t len, unsigned int hash);
+// Make ix (built on the heap) the server's index and retire the old one.
+void docroot_install(struct docroot_index *ix);
+
+#endif
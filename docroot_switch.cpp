@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "docroot_switch.h"
+#include "docroot_index.h"
+#include "file_cache.h"
+#include "server_core.h"
+
+enum entry_action { ENTRY_KEEP, ENTRY_SHARE, ENTRY_REPLACE, ENTRY_DROP };
+
+struct entry_list {
+    struct cache_entry **entries;
+    size_t count, cap;
+};
+
+static char root_link[PATH_MAX];      // absolute, as polls run inside a release
+static int index_threads;
+static char current_target[PATH_MAX];
+static char failed_target[PATH_MAX];
+static pid_t running_pid;         // the process the thread runs in
+static pthread_mutex_t start_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void collect_entry(struct cache_entry *e, void *arg) {
+    struct entry_list *list = (struct entry_list *)arg;
+    if (list->count == list->cap) {
+        size_t cap = list->cap ? list->cap * 2 : 1024;
+        struct cache_entry **entries = (struct cache_entry **)realloc(list->entries, cap * sizeof(*entries));
+        if (!entries) return;
+        list->entries = entries;
+        list->cap = cap;
+    }
+    file_cache_ref(e);
+    list->entries[list->count++] = e;
+}
+
+// Read e's file from the new tree and decide what becomes of e at the switch.
+static enum entry_action prepare_entry(int root_fd, struct docroot_index *ix, struct cache_entry *e,
+                                       struct cache_entry **loaded) {
+    const struct docroot_file *f = docroot_index_find(ix, e->key.str, e->key.len, e->key.hash);
+    if (!f || f->size > FILE_CACHE_MAX_OBJECT) return ENTRY_DROP;
+    int fd = openat(root_fd, e->key.str, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return ENTRY_DROP;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return ENTRY_DROP;
+    }
+    // A hard link into the new tree is the same version.
+    if (st.st_ino == e->st.st_ino && st.st_dev == e->st.st_dev && st.st_size == e->st.st_size &&
+        st.st_mtim.tv_sec == e->st.st_mtim.tv_sec && st.st_mtim.tv_nsec == e->st.st_mtim.tv_nsec) {
+        close(fd);
+        return ENTRY_KEEP;
+    }
+    *loaded = file_cache_load(fd, 0, &st, monotonic_ms());
+    close(fd);
+    if (!*loaded) return ENTRY_DROP;
+    if ((*loaded)->size == e->size && memcmp((*loaded)->data, e->data, e->size) == 0) {
+        file_cache_share(e, &st);
+        file_cache_discard(*loaded);
+        *loaded = NULL;
+        return ENTRY_SHARE;
+    }
+    return ENTRY_REPLACE;
+}
+
+static int switch_to(const char *target) {
+    long long start = monotonic_ms();
+    int root_fd = open(target, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (root_fd < 0) return -1;
+    struct docroot_index *ix = (struct docroot_index *)malloc(sizeof(*ix));
+    if (!ix || docroot_index_build(ix, target, index_threads) < 0) {
+        if (ix) docroot_index_destroy(ix);
+        free(ix);
+        close(root_fd);
+        return -1;
+    }
+
+    struct entry_list list = { NULL, 0, 0 };
+    file_cache_for_each(collect_entry, &list);
+    struct cache_entry **loaded = (struct cache_entry **)calloc(list.count + 1, sizeof(*loaded));
+    unsigned char *actions = (unsigned char *)malloc(list.count + 1);
+    size_t counts[4] = { 0, 0, 0, 0 };
+    int ret = loaded && actions ? 0 : -1;
+    for (size_t i = 0; ret == 0 && i < list.count; ++i) {
+        actions[i] = prepare_entry(root_fd, ix, list.entries[i], &loaded[i]);
+        counts[actions[i]]++;
+    }
+    if (ret == 0 && fchdir(root_fd) < 0) ret = -1;
+
+    for (size_t i = 0; i < list.count; ++i) {
+        struct cache_entry *e = list.entries[i];
+        if (ret == 0 && actions[i] >= ENTRY_REPLACE && ebr_enter() == 0) {
+            if (actions[i] == ENTRY_REPLACE) {
+                file_cache_publish(loaded[i], e->key.str, e->key.len, e->key.hash);
+                loaded[i] = NULL;
+            } else {
+                file_cache_remove(e->key.str, e->key.len, e->key.hash);
+            }
+            ebr_exit();
+        }
+        if (loaded && loaded[i]) file_cache_discard(loaded[i]);
+        file_cache_release(e);
+    }
+    free(list.entries);
+    free(loaded);
+    free(actions);
+    close(root_fd);
+    if (ret < 0) {
+        docroot_index_destroy(ix);
+        free(ix);
+        return -1;
+    }
+    docroot_install(ix);
+    fprintf(stderr, "[%d] docroot switch: %s -> %s: files=%zu cached=%zu shared=%zu reloaded=%zu dropped=%zu ms=%lld\n",
+            (int)getpid(), current_target, target, ix->files, list.count, counts[ENTRY_KEEP] + counts[ENTRY_SHARE],
+            counts[ENTRY_REPLACE], counts[ENTRY_DROP], monotonic_ms() - start);
+    return 0;
+}
+
+static void *watch_root(void *arg) {
+    (void)arg;
+    while (1) {
+        usleep(DOCROOT_SWITCH_POLL_MS * 1000);
+        // The link may be missing for a moment while it is replaced.
+        char target[PATH_MAX];
+        if (!realpath(root_link, target) || strcmp(target, current_target) == 0 ||
+            strcmp(target, failed_target) == 0)
+            continue;
+        if (switch_to(target) == 0) {
+            strcpy(current_target, target);
+            failed_target[0] = '\0';
+        } else {
+            log_error("docroot switch failed", 0);
+            strcpy(failed_target, target);
+        }
+    }
+    return NULL;
+}
+
+int docroot_switch_configure(const char *link, int threads) {
+    if (!link) return 0;
+    // The link itself must stay a link: resolve only its directory.
+    char path[PATH_MAX], dir[PATH_MAX];
+    size_t len = strlen(link);
+    while (len > 1 && link[len - 1] == '/') len--;
+    if (len >= sizeof(path)) return -1;
+    memcpy(path, link, len);
+    path[len] = '\0';
+    char *slash = strrchr(path, '/');
+    const char *base = slash ? slash + 1 : path;
+    if (slash) *slash = '\0';
+    if (!realpath(!slash ? "." : slash == path ? "/" : path, dir)) return -1;
+    if (snprintf(root_link, sizeof(root_link), "%s/%s", strcmp(dir, "/") == 0 ? "" : dir, base) >=
+        (int)sizeof(root_link))
+        return -1;
+    if (!realpath(root_link, current_target) || chdir(current_target) < 0) return -1;
+    index_threads = threads;
+    return 0;
+}
+
+int docroot_switch_start(void) {
+    if (!root_link[0]) return 0;
+    pthread_mutex_lock(&start_lock);
+    int ret = 0;
+    // A forked child inherits running_pid but not the thread.
+    if (running_pid != getpid()) {
+        ret = start_background_thread(watch_root, NULL);
+        if (ret == 0) running_pid = getpid();
+    }
+    pthread_mutex_unlock(&start_lock);
+    return ret;
+}
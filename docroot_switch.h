@@ -0,0 +1,41 @@
+#ifndef DOCROOT_SWITCH_H
+#define DOCROOT_SWITCH_H
+
+/*
+ * Versioned document roots, for deploys that flip a symlink to a new
+ * release directory.
+ *
+ * Requests resolve paths against the working directory. With a root
+ * configured, the server changes into the directory the link points to
+ * at startup. A background thread then checks the link every
+ * DOCROOT_SWITCH_POLL_MS. When the link points somewhere new, the thread
+ * prepares the new version while requests are still served from the old:
+ *
+ *  - it indexes the new tree (docroot_index.h);
+ *  - every file in the memory cache (file_cache.h) is read from the new
+ *    tree. When the bytes are the same, the entry is shared: it stays
+ *    valid for the new file's version, with its old headers. Otherwise the
+ *    new bytes go into an entry that is not indexed yet. Entries for files
+ *    the new tree lacks are noted.
+ *
+ * The switch itself is one fchdir(). Right after it, the new entries
+ * replace the old ones, the noted ones are dropped and the new index is
+ * installed. Cached files thus stay cached across a deploy, and a changed
+ * one is served from its old entry only while the switch publishes, well
+ * within FILE_CACHE_VALIDATE_MS. The spill tier (spill_cache.h) is not
+ * prepared; its entries revalidate as usual.
+ *
+ * The working directory and the cache are per process, so every serving
+ * process runs its own thread, like the Date timer.
+ */
+
+#define DOCROOT_SWITCH_POLL_MS 1000
+
+// Change into the directory link points to, and watch link, by its
+// absolute path, from docroot_switch_start(). threads builds each new
+// index. -1 when link does not lead to a directory.
+int docroot_switch_configure(const char *link, int threads);
+// Start the watcher in this process (after any fork).
+int docroot_switch_start(void);
+
+#endif
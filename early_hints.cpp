@@ -0,0 +1,241 @@
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "early_hints.h"
+#include "version_table.h"
+#include "header_builder.h"
+#include "file_cache.h"
+#include "server_core.h"
+
+struct page_link {
+    const char *url;
+    size_t len;
+    int script;
+};
+
+static int enabled;
+
+// The value of attribute name in the tag text [p, end), or NULL.
+static const char *tag_attr(const char *p, const char *end, const char *name, size_t *len) {
+    size_t name_len = strlen(name);
+    while (p < end) {
+        while (p < end && (isspace((unsigned char)*p) || *p == '/')) p++;
+        const char *attr = p;
+        while (p < end && !isspace((unsigned char)*p) && *p != '=' && *p != '/') p++;
+        size_t attr_len = p - attr;
+        while (p < end && isspace((unsigned char)*p)) p++;
+        const char *value = p;
+        size_t value_len = 0;
+        if (p < end && *p == '=') {
+            p++;
+            while (p < end && isspace((unsigned char)*p)) p++;
+            if (p < end && (*p == '"' || *p == '\'')) {
+                char quote = *p++;
+                value = p;
+                while (p < end && *p != quote) p++;
+                value_len = p - value;
+                if (p < end) p++;
+            } else {
+                value = p;
+                while (p < end && !isspace((unsigned char)*p)) p++;
+                value_len = p - value;
+            }
+        } else if (attr_len == 0) {
+            p++;
+        }
+        if (attr_len == name_len && strncasecmp(attr, name, name_len) == 0) {
+            *len = value_len;
+            return value;
+        }
+    }
+    return NULL;
+}
+
+static int has_token(const char *p, size_t len, const char *token) {
+    size_t token_len = strlen(token);
+    for (size_t i = 0; i + token_len <= len; ++i) {
+        if ((i == 0 || isspace((unsigned char)p[i - 1])) && strncasecmp(p + i, token, token_len) == 0 &&
+            (i + token_len == len || isspace((unsigned char)p[i + token_len])))
+            return 1;
+    }
+    return 0;
+}
+
+static int is_tag(const char *p, const char *name) {
+    size_t n = strlen(name);
+    return strncasecmp(p, name, n) == 0 && (isspace((unsigned char)p[n]) || p[n] == '>' || p[n] == '/');
+}
+
+// Same-site URLs only, and nothing that needs quoting in a Link header.
+static int hintable_url(const char *url, size_t len) {
+    if (len == 0 || len > 200 || (len >= 2 && url[0] == '/' && url[1] == '/')) return 0;
+    for (size_t i = 0; i < len; ++i) {
+        unsigned char c = url[i];
+        if (c <= ' ' || c >= 0x7f || c == ':' || c == '<' || c == '>' || c == ',' || c == ';' || c == '"' ||
+            c == '\'' || c == '\\')
+            return 0;
+    }
+    return 1;
+}
+
+// Stylesheets and classic scripts the page (NUL-terminated) refers to.
+static size_t find_links(const char *html, struct page_link *links) {
+    size_t count = 0;
+    const char *p = html;
+    while (count < EARLY_HINTS_MAX_LINKS && (p = strchr(p, '<'))) {
+        if (strncmp(p, "<!--", 4) == 0) {
+            p = strstr(p + 4, "-->");
+            if (!p) break;
+            continue;
+        }
+        const char *end = strchr(p, '>');
+        if (!end) break;
+        const char *url = NULL, *value;
+        size_t url_len = 0, value_len;
+        int script = 0;
+        if (is_tag(p + 1, "link")) {
+            value = tag_attr(p + 5, end, "rel", &value_len);
+            // Alternate stylesheets are not applied, so not worth fetching early.
+            if (value && has_token(value, value_len, "stylesheet") && !has_token(value, value_len, "alternate"))
+                url = tag_attr(p + 5, end, "href", &url_len);
+        } else if (is_tag(p + 1, "script")) {
+            // A module script would be fetched twice after a classic preload.
+            value = tag_attr(p + 7, end, "type", &value_len);
+            if (!value || value_len != 6 || strncasecmp(value, "module", 6) != 0)
+                url = tag_attr(p + 7, end, "src", &url_len);
+            script = 1;
+        }
+        if (url && hintable_url(url, url_len)) {
+            links[count].url = url;
+            links[count].len = url_len;
+            links[count].script = script;
+            count++;
+        }
+        p = end + 1;
+        // Nothing inside a script is markup.
+        if (script && !(p = strcasestr(p, "</script"))) break;
+    }
+    return count;
+}
+
+// The file a link names, from the page's directory or the root. 0 when it
+// is not one we would serve.
+static size_t asset_path(const char *page, const struct page_link *link, char *out, size_t out_size) {
+    size_t len = 0;
+    while (len < link->len && link->url[len] != '?' && link->url[len] != '#') len++;
+    const char *url = link->url;
+    size_t base_len = 0;
+    if (url[0] == '/') {
+        url++;
+        len--;
+    } else {
+        const char *slash = strrchr(page, '/');
+        base_len = slash ? slash - page + 1 : 0;
+    }
+    if (len == 0 || base_len + len >= out_size) return 0;
+    memcpy(out, page, base_len);
+    memcpy(out + base_len, url, len);
+    out[base_len + len] = '\0';
+    int depth = 1;
+    for (size_t i = 0; i < base_len + len; ++i) depth += out[i] == '/';
+    return depth > MAX_PATH_DEPTH || strstr(out, "..") ? 0 : base_len + len;
+}
+
+// Read the asset into the memory cache unless it is there.
+static void warm_asset(const char *path, size_t len) {
+    if (ebr_enter() < 0) return;
+    unsigned int hash = file_cache_hash(path);
+    long long now = monotonic_ms();
+    if (!file_cache_lookup(path, len, hash, now)) {
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) file_cache_insert(path, len, hash, fd, 0, &st, now);
+        if (fd >= 0) close(fd);
+    }
+    ebr_exit();
+}
+
+// Parse the page if it is still the version queued: the interim response
+// into text, then warm what it links.
+static int parse_page(const struct path_version *job, char *text, size_t *text_len) {
+    if (job->size > FILE_CACHE_MAX_OBJECT) return -1;
+    int fd = open(job->path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct stat st;
+    char *html = NULL;
+    size_t got = 0;
+    if (fstat(fd, &st) == 0 && path_version_matches(job, &st) && (html = (char *)malloc(job->size + 1))) {
+        while (got < (size_t)job->size) {
+            ssize_t n = pread(fd, html + got, job->size - got, got);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            got += n;
+        }
+    }
+    close(fd);
+    if (!html || got != (size_t)job->size) {
+        free(html);
+        return -1;
+    }
+    html[got] = '\0';
+
+    struct page_link links[EARLY_HINTS_MAX_LINKS];
+    size_t count = find_links(html, links);
+    struct header_builder b;
+    hb_init(&b, text, EARLY_HINTS_SIZE);
+    hb_append_str(&b, "HTTP/1.1 103 Early Hints\r\nLink: ");
+    size_t used = 0;
+    for (size_t i = 0; i < count; ++i) {
+        // Leave room for the separator and the blank line after the field.
+        if (b.len + links[i].len + 32 + 6 > EARLY_HINTS_SIZE) break;
+        if (used++) hb_append_str(&b, ", ");
+        hb_append(&b, "<", 1);
+        hb_append(&b, links[i].url, links[i].len);
+        hb_append_str(&b, links[i].script ? ">; rel=preload; as=script" : ">; rel=preload; as=style");
+    }
+    hb_append_str(&b, "\r\n\r\n");
+    *text_len = used ? hb_finish(&b) : 0;
+
+    char path[256];
+    for (size_t i = 0; i < count; ++i) {
+        size_t len = asset_path(job->path, &links[i], path, sizeof(path));
+        if (len) warm_asset(path, len);
+    }
+    free(html);
+    return 0;
+}
+
+// A page we cannot parse is kept as one with no hints, so that its version
+// is not queued again on every request.
+static int hints_job(const struct path_version *v, void *result) {
+    size_t len = 0;
+    if (parse_page(v, (char *)result, &len) < 0) len = 0;
+    return (int)len;
+}
+
+static struct version_table table =
+    VERSION_TABLE_INIT(EARLY_HINTS_SLOTS, EARLY_HINTS_SIZE, EARLY_HINTS_QUEUE, hints_job);
+
+void early_hints_configure(int on) {
+    enabled = on;
+}
+
+int early_hints_enabled(void) {
+    return enabled;
+}
+
+int early_hints_start(void) {
+    if (!enabled) return 0;
+    return version_table_start(&table, 1);
+}
+
+size_t early_hints_copy(const char *path, const struct stat *st, char *dst, size_t dst_size) {
+    if (!enabled) return 0;
+    int len = version_table_lookup(&table, path, st, dst, dst_size);
+    return len > 0 ? len : 0;
+}
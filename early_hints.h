@@ -0,0 +1,42 @@
+#ifndef EARLY_HINTS_H
+#define EARLY_HINTS_H
+
+#include <stddef.h>
+#include <sys/stat.h>
+
+/*
+ * 103 Early Hints for HTML pages.
+ *
+ * When enabled, each HTML file version (path, size, mtime) is parsed once
+ * by a background thread, the way etag.h hashes files. The thread looks
+ * for <link rel="stylesheet" href> and <script src> with same-site URLs,
+ * at most EARLY_HINTS_MAX_LINKS of them, and keeps an interim response:
+ *
+ *   HTTP/1.1 103 Early Hints
+ *   Link: </site.css>; rel=preload; as=style, </app.js>; rel=preload; as=script
+ *
+ * It then reads those assets into the memory cache (file_cache.h), so the
+ * requests the hints start are cache hits. The page's response starts with
+ * the interim one once it is ready; until then, and for a version not seen
+ * yet, it goes out without. Results live in EARLY_HINTS_SLOTS slots (see
+ * version_table.h). Pages over FILE_CACHE_MAX_OBJECT
+ * are not parsed; like pages that fail to parse, their version is kept as
+ * one with no hints. HTTP/1.0 clients get no interim response, and nor do
+ * forked per-connection children (fork, spawn), which run no thread.
+ */
+
+#define EARLY_HINTS_SLOTS 1024
+#define EARLY_HINTS_SIZE 512        // interim response, within RESPONSE_HEADER_SIZE
+#define EARLY_HINTS_MAX_LINKS 8
+#define EARLY_HINTS_QUEUE 64
+
+void early_hints_configure(int enabled);
+int early_hints_enabled(void);
+// Start the parsing thread in this process, once.
+int early_hints_start(void);
+// Copy the interim response for HTML page path at version st into dst;
+// returns its length, or 0 when there is none yet (the version is then
+// queued for parsing).
+size_t early_hints_copy(const char *path, const struct stat *st, char *dst, size_t dst_size);
+
+#endif
@@ -0,0 +1,117 @@
+#include <stddef.h>
+#include <pthread.h>
+
+#include "ebr.h"
+
+// local_epoch is (epoch << 1) | 1 inside a section and 0 outside.
+struct ebr_record {
+    unsigned long local_epoch;
+    int in_use;
+    char pad[64 - sizeof(unsigned long) - sizeof(int)];
+} __attribute__((aligned(64)));
+
+static struct ebr_record records[EBR_MAX_THREADS];
+static int records_used;                // high-water mark of claimed records
+static unsigned long global_epoch;
+static struct ebr_node *limbo[3];       // retired in epoch e, kept in limbo[e % 3]
+static pthread_mutex_t limbo_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t record_key;
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+
+static __thread struct ebr_record *self;
+static __thread int depth;
+static __thread unsigned int exits;
+
+static void release_record(void *arg) {
+    struct ebr_record *r = (struct ebr_record *)arg;
+    __atomic_store_n(&r->local_epoch, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&r->in_use, 0, __ATOMIC_RELEASE);
+}
+
+static void create_key(void) {
+    pthread_key_create(&record_key, release_record);
+}
+
+static int claim_record(void) {
+    pthread_once(&key_once, create_key);
+    for (int i = 0; i < EBR_MAX_THREADS; ++i) {
+        int expected = 0;
+        if (__atomic_load_n(&records[i].in_use, __ATOMIC_RELAXED) == 0 &&
+            __atomic_compare_exchange_n(&records[i].in_use, &expected, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            int used = __atomic_load_n(&records_used, __ATOMIC_RELAXED);
+            while (used < i + 1 &&
+                   !__atomic_compare_exchange_n(&records_used, &used, i + 1, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {}
+            self = &records[i];
+            pthread_setspecific(record_key, self);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Caller holds limbo_lock. Returns the list that became safe to reclaim.
+static struct ebr_node *advance_locked(void) {
+    unsigned long epoch = __atomic_load_n(&global_epoch, __ATOMIC_RELAXED);
+    unsigned long current = (epoch << 1) | 1;
+    int used = __atomic_load_n(&records_used, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    for (int i = 0; i < used; ++i) {
+        unsigned long local = __atomic_load_n(&records[i].local_epoch, __ATOMIC_ACQUIRE);
+        if (local != 0 && local != current) return NULL;
+    }
+    // Everything retired two epochs ago is unreachable now.
+    __atomic_store_n(&global_epoch, epoch + 1, __ATOMIC_RELEASE);
+    struct ebr_node *ready = limbo[(epoch + 1) % 3];
+    limbo[(epoch + 1) % 3] = NULL;
+    return ready;
+}
+
+static void reclaim_list(struct ebr_node *node) {
+    while (node) {
+        struct ebr_node *next = node->next;
+        node->reclaim(node);
+        node = next;
+    }
+}
+
+static void try_advance(void) {
+    if (pthread_mutex_trylock(&limbo_lock) != 0) return;
+    struct ebr_node *ready = advance_locked();
+    pthread_mutex_unlock(&limbo_lock);
+    reclaim_list(ready);
+}
+
+int ebr_enter(void) {
+    if (depth > 0) {
+        depth++;
+        return 0;
+    }
+    if (!self && claim_record() < 0) return -1;
+    depth = 1;
+    unsigned long epoch = __atomic_load_n(&global_epoch, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&self->local_epoch, (epoch << 1) | 1, __ATOMIC_RELAXED);
+    // Publish the epoch before any protected pointer is read.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return 0;
+}
+
+void ebr_exit(void) {
+    if (--depth > 0) return;
+    __atomic_store_n(&self->local_epoch, 0, __ATOMIC_RELEASE);
+    if (++exits % EBR_ADVANCE_EVERY == 0) try_advance();
+}
+
+int ebr_active(void) {
+    return depth > 0;
+}
+
+void ebr_retire(struct ebr_node *node, void (*reclaim)(struct ebr_node *node)) {
+    node->reclaim = reclaim;
+    pthread_mutex_lock(&limbo_lock);
+    unsigned long epoch = __atomic_load_n(&global_epoch, __ATOMIC_RELAXED);
+    node->next = limbo[epoch % 3];
+    limbo[epoch % 3] = node;
+    struct ebr_node *ready = advance_locked();
+    pthread_mutex_unlock(&limbo_lock);
+    reclaim_list(ready);
+}
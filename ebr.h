@@ -0,0 +1,35 @@
+#ifndef EBR_H
+#define EBR_H
+
+/*
+ * Epoch-based reclamation for structures read without locks.
+ *
+ * Readers bracket their accesses with ebr_enter()/ebr_exit(). That only
+ * stores to the thread's own record (one cache line, claimed on first use
+ * and given back at thread exit), so it causes no cross-core traffic.
+ * Writers unlink an object and pass it to ebr_retire(). It is reclaimed
+ * once the global epoch has advanced twice. The epoch can only advance when
+ * every thread inside a section has seen the current one, so no reader can
+ * still hold the object.
+ *
+ * A pointer obtained inside a section is valid until ebr_exit(). Anything
+ * kept longer needs its own reference, taken before the section ends.
+ * Sections nest. ebr_enter() fails when all EBR_MAX_THREADS records are in
+ * use; the caller must then not touch EBR-protected data.
+ */
+
+#define EBR_MAX_THREADS 4096
+#define EBR_ADVANCE_EVERY 64        // exits between attempts to advance the epoch
+
+struct ebr_node {
+    struct ebr_node *next;
+    void (*reclaim)(struct ebr_node *node);
+};
+
+int ebr_enter(void);
+void ebr_exit(void);
+// True inside a section entered by this thread.
+int ebr_active(void);
+void ebr_retire(struct ebr_node *node, void (*reclaim)(struct ebr_node *node));
+
+#endif
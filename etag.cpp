@@ -0,0 +1,72 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "etag.h"
+#include "content_hash.h"
+#include "version_table.h"
+
+#define ETAG_READ_CHUNK (256 * 1024)    // a multiple of CONTENT_HASH_STRIPE
+
+static int enabled;
+
+// Hash the file if it is still the version that was queued.
+static int hash_file(const struct path_version *v, void *result) {
+    int fd = open(v->path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !path_version_matches(v, &st)) {
+        close(fd);
+        return -1;
+    }
+    // Read rather than map, so a file truncated meanwhile is an error, not SIGBUS.
+    char *buf = (char *)malloc(ETAG_READ_CHUNK);
+    if (!buf) {
+        close(fd);
+        return -1;
+    }
+    struct content_hasher h;
+    content_hash_init(&h);
+    off_t done = 0;
+    while (done < v->size) {
+        size_t want = v->size - done < ETAG_READ_CHUNK ? v->size - done : ETAG_READ_CHUNK;
+        size_t got = 0;
+        while (got < want) {
+            ssize_t n = pread(fd, buf + got, want - got, done + got);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            got += n;
+        }
+        if (got != want) break;
+        content_hash_update(&h, buf, got);
+        done += got;
+    }
+    free(buf);
+    close(fd);
+    if (done != v->size) return -1;
+    uint64_t hash = content_hash_final(&h);
+    memcpy(result, &hash, sizeof(hash));
+    return sizeof(hash);
+}
+
+static struct version_table table = VERSION_TABLE_INIT(ETAG_SLOTS, sizeof(uint64_t), ETAG_QUEUE, hash_file);
+
+void etag_configure(int strong) {
+    enabled = strong;
+}
+
+int etag_enabled(void) {
+    return enabled;
+}
+
+int etag_start(void) {
+    if (!enabled) return 0;
+    return version_table_start(&table, ETAG_THREADS);
+}
+
+int etag_lookup(const char *path, const struct stat *st, uint64_t *hash) {
+    if (!enabled) return 0;
+    return version_table_lookup(&table, path, st, hash, sizeof(*hash)) == (int)sizeof(*hash);
+}
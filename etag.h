@@ -0,0 +1,32 @@
+#ifndef ETAG_H
+#define ETAG_H
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+/*
+ * Strong ETags from file contents, for deployments where the same file has
+ * a different inode or mtime on every host.
+ *
+ * When enabled, each file version (path, size, mtime) gets a content_hash()
+ * (content_hash.h). Requests never hash. The first request for a version
+ * queues it, and one of ETAG_THREADS background threads reads the file,
+ * hashes it and stores the result in one of ETAG_SLOTS slots (see
+ * version_table.h). Until then responses carry the weak validator,
+ * W/"<mtime>-<size>". Processes that did not call etag_start(), such as forked per-connection
+ * children, always serve the weak validator.
+ */
+
+#define ETAG_SLOTS 4096
+#define ETAG_THREADS 2
+#define ETAG_QUEUE 256
+
+void etag_configure(int strong);
+int etag_enabled(void);
+// Start the hashing threads in this process, once.
+int etag_start(void);
+// The content hash of path at version st, or 0 when it is not ready yet;
+// in that case the version is queued for hashing.
+int etag_lookup(const char *path, const struct stat *st, uint64_t *hash);
+
+#endif
@@ -0,0 +1,410 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "file_cache.h"
+
+struct cache_shard {
+    pthread_mutex_t lock;           // writers only
+    struct flat_index index;
+    struct cache_entry *hand;       // CLOCK ring of indexed entries
+    size_t bytes;
+};
+
+static struct cache_shard shards[FILE_CACHE_SHARDS];
+static pthread_once_t shards_once = PTHREAD_ONCE_INIT;
+static unsigned long generation;
+static void (*evict_hook)(struct cache_entry *e);
+
+static void init_shards(void) {
+    for (int i = 0; i < FILE_CACHE_SHARDS; ++i) {
+        pthread_mutex_init(&shards[i].lock, NULL);
+        flat_index_init(&shards[i].index);
+    }
+}
+
+static struct cache_shard *shard_for(unsigned int hash) {
+    pthread_once(&shards_once, init_shards);
+    return &shards[hash % FILE_CACHE_SHARDS];
+}
+
+unsigned int file_cache_hash(const char *path) {
+    unsigned int h = FILE_CACHE_HASH_SEED;
+    for (; *path; ++path) h = file_cache_hash_step(h, *path);
+    return h;
+}
+
+void file_cache_set_evict_hook(void (*hook)(struct cache_entry *e)) {
+    evict_hook = hook;
+}
+
+void file_cache_for_each(void (*fn)(struct cache_entry *e, void *arg), void *arg) {
+    for (int i = 0; i < FILE_CACHE_SHARDS; ++i) {
+        struct cache_shard *s = shard_for(i);
+        pthread_mutex_lock(&s->lock);
+        struct cache_entry *e = s->hand;
+        if (e) {
+            do {
+                fn(e, arg);
+                e = e->clock_next;
+            } while (e != s->hand);
+        }
+        pthread_mutex_unlock(&s->lock);
+    }
+}
+
+// A thread's hit counts. Each slot packs a path hash (high half) and its
+// count (low half) into one word that only the owner writes, so the folder
+// reads both at once.
+struct hit_table {
+    uint64_t slots[FILE_CACHE_HIT_SLOTS];
+    uint64_t folded[FILE_CACHE_HIT_SLOTS];      // slots as last folded, under hit_tables_lock
+    struct hit_table *next;
+};
+
+// What exited threads had not had folded, merged the same way.
+static struct hit_table exited_hits;
+static struct hit_table *hit_tables = &exited_hits;
+static pthread_mutex_t hit_tables_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t hit_key;
+static pthread_once_t hit_once = PTHREAD_ONCE_INIT;
+static __thread struct hit_table *local_hits;
+
+struct fold_slot {
+    unsigned int hash;
+    unsigned int hits;
+    int used;
+};
+
+// Open addressing over the hashes of the entries indexed when the fold began.
+struct hit_fold {
+    struct fold_slot *slots;
+    size_t mask;
+    unsigned int *hashes;
+    size_t count, cap;
+};
+
+static uint64_t hit_word(unsigned int hash, unsigned int count) {
+    return (uint64_t)hash << 32 | count;
+}
+
+// Hits in word since folded, or all of them when the slot changed paths.
+static unsigned int unfolded(uint64_t word, uint64_t folded) {
+    return word >> 32 == folded >> 32 ? (unsigned int)word - (unsigned int)folded : (unsigned int)word;
+}
+
+// Under hit_tables_lock. On a collision the path with more hits stays.
+static void add_exited(unsigned int hash, unsigned int hits) {
+    size_t i = hash % FILE_CACHE_HIT_SLOTS;
+    uint64_t word = exited_hits.slots[i];
+    if (word >> 32 == hash) {
+        exited_hits.slots[i] = hit_word(hash, (unsigned int)word + hits);
+    } else if (unfolded(word, exited_hits.folded[i]) < hits) {
+        exited_hits.slots[i] = hit_word(hash, hits);
+        exited_hits.folded[i] = hit_word(hash, 0);
+    }
+}
+
+static void drop_hit_table(void *arg) {
+    struct hit_table *t = (struct hit_table *)arg;
+    pthread_mutex_lock(&hit_tables_lock);
+    for (struct hit_table **p = &hit_tables; *p; p = &(*p)->next) {
+        if (*p == t) {
+            *p = t->next;
+            break;
+        }
+    }
+    for (size_t i = 0; i < FILE_CACHE_HIT_SLOTS; ++i) {
+        unsigned int hits = unfolded(t->slots[i], t->folded[i]);
+        if (hits) add_exited(t->slots[i] >> 32, hits);
+    }
+    pthread_mutex_unlock(&hit_tables_lock);
+    free(t);
+}
+
+static void create_hit_key(void) {
+    pthread_key_create(&hit_key, drop_hit_table);
+}
+
+static struct hit_table *register_hit_table(void) {
+    struct hit_table *t = (struct hit_table *)calloc(1, sizeof(*t));
+    if (!t) return NULL;
+    pthread_once(&hit_once, create_hit_key);
+    pthread_setspecific(hit_key, t);
+    pthread_mutex_lock(&hit_tables_lock);
+    t->next = hit_tables;
+    hit_tables = t;
+    pthread_mutex_unlock(&hit_tables_lock);
+    return local_hits = t;
+}
+
+void file_cache_count_hit(struct cache_entry *e) {
+    struct hit_table *t = local_hits ? local_hits : register_hit_table();
+    if (!t) return;
+    uint64_t *slot = &t->slots[e->key.hash % FILE_CACHE_HIT_SLOTS];
+    uint64_t word = *slot;
+    // The count wraps within its half; the fold takes differences.
+    word = word >> 32 == e->key.hash ? hit_word(e->key.hash, (unsigned int)word + 1) : hit_word(e->key.hash, 1);
+    __atomic_store_n(slot, word, __ATOMIC_RELAXED);
+}
+
+static void collect_hash(struct cache_entry *e, void *arg) {
+    struct hit_fold *f = (struct hit_fold *)arg;
+    if (f->count == f->cap) {
+        size_t cap = f->cap ? f->cap * 2 : 1024;
+        unsigned int *hashes = (unsigned int *)realloc(f->hashes, cap * sizeof(*hashes));
+        if (!hashes) return;
+        f->hashes = hashes;
+        f->cap = cap;
+    }
+    f->hashes[f->count++] = e->key.hash;
+}
+
+static struct fold_slot *fold_find(struct hit_fold *f, unsigned int hash) {
+    size_t i = hash & f->mask;
+    while (f->slots[i].used && f->slots[i].hash != hash) i = (i + 1) & f->mask;
+    return &f->slots[i];
+}
+
+static void apply_hits(struct cache_entry *e, void *arg) {
+    struct fold_slot *s = fold_find((struct hit_fold *)arg, e->key.hash);
+    if (s->used) __atomic_store_n(&e->hits, e->hits + s->hits, __ATOMIC_RELAXED);
+}
+
+void file_cache_fold_hits(void) {
+    struct hit_fold f = { NULL, 0, NULL, 0, 0 };
+    file_cache_for_each(collect_hash, &f);
+    size_t size = 1024;
+    while (size < 2 * f.count) size *= 2;
+    f.slots = (struct fold_slot *)calloc(size, sizeof(*f.slots));
+    if (!f.slots) {
+        free(f.hashes);
+        return;
+    }
+    f.mask = size - 1;
+    for (size_t i = 0; i < f.count; ++i) {
+        struct fold_slot *s = fold_find(&f, f.hashes[i]);
+        s->hash = f.hashes[i];
+        s->used = 1;
+    }
+    free(f.hashes);
+
+    // Hits on paths not cached when the fold began are dropped.
+    pthread_mutex_lock(&hit_tables_lock);
+    for (struct hit_table *t = hit_tables; t; t = t->next) {
+        for (size_t i = 0; i < FILE_CACHE_HIT_SLOTS; ++i) {
+            uint64_t word = __atomic_load_n(&t->slots[i], __ATOMIC_RELAXED);
+            unsigned int hits = unfolded(word, t->folded[i]);
+            t->folded[i] = word;
+            if (!hits) continue;
+            struct fold_slot *s = fold_find(&f, word >> 32);
+            if (s->used) s->hits += hits;
+        }
+    }
+    pthread_mutex_unlock(&hit_tables_lock);
+    file_cache_for_each(apply_hits, &f);
+    free(f.slots);
+}
+
+unsigned long file_cache_generation(void) {
+    return __atomic_load_n(&generation, __ATOMIC_ACQUIRE);
+}
+
+void file_cache_ref(struct cache_entry *e) {
+    __atomic_fetch_add(&e->refs, 1, __ATOMIC_RELAXED);
+}
+
+void file_cache_release(struct cache_entry *e) {
+    if (__atomic_sub_fetch(&e->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        index_key_release(&e->key);
+        free(e);
+    }
+}
+
+// After the grace period no reader can take a new reference.
+static void drop_cache_ref(struct ebr_node *node) {
+    file_cache_release((struct cache_entry *)((char *)node - offsetof(struct cache_entry, retired)));
+}
+
+// The shard lock is held for the ring and the unlink.
+static void clock_insert(struct cache_shard *s, struct cache_entry *e) {
+    if (!s->hand) {
+        e->clock_prev = e->clock_next = e;
+        s->hand = e;
+        return;
+    }
+    // Just behind the hand, so a new entry is the last one the sweep reaches.
+    e->clock_next = s->hand;
+    e->clock_prev = s->hand->clock_prev;
+    e->clock_prev->clock_next = e;
+    s->hand->clock_prev = e;
+}
+
+static void clock_remove(struct cache_shard *s, struct cache_entry *e) {
+    if (e->clock_next == e) {
+        s->hand = NULL;
+        return;
+    }
+    e->clock_prev->clock_next = e->clock_next;
+    e->clock_next->clock_prev = e->clock_prev;
+    if (s->hand == e) s->hand = e->clock_next;
+}
+
+// Take e out of the index. Readers that already found it keep using it;
+// the cache's reference goes after a grace period.
+static void unlink_entry(struct cache_shard *s, struct cache_entry *e) {
+    flat_index_remove(&s->index, &e->key);
+    clock_remove(s, e);
+    s->bytes -= e->size;
+    __atomic_store_n(&e->linked, 0, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&generation, 1, __ATOMIC_RELEASE);
+    ebr_retire(&e->retired, drop_cache_ref);
+}
+
+// Second chance: skip and clear entries looked up since the last sweep.
+static struct cache_entry *clock_victim(struct cache_shard *s) {
+    while (__atomic_load_n(&s->hand->referenced, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&s->hand->referenced, 0, __ATOMIC_RELAXED);
+        s->hand = s->hand->clock_next;
+    }
+    return s->hand;
+}
+
+static struct cache_entry *find(struct cache_shard *s, const char *path, size_t len, unsigned int hash) {
+    return (struct cache_entry *)flat_index_find(&s->index, path, len, hash);
+}
+
+static int same_version(const struct stat *a, const struct stat *b) {
+    return a->st_size == b->st_size && a->st_mtim.tv_sec == b->st_mtim.tv_sec &&
+           a->st_mtim.tv_nsec == b->st_mtim.tv_nsec && a->st_ino == b->st_ino;
+}
+
+// The shard lock is held.
+static int is_alias(const struct cache_entry *e, const struct stat *st) {
+    unsigned int n = e->alias_count < FILE_CACHE_ALIASES ? e->alias_count : FILE_CACHE_ALIASES;
+    for (unsigned int i = 0; i < n; ++i) {
+        const struct file_version *v = &e->aliases[i];
+        if (v->size == st->st_size && v->mtime_sec == st->st_mtim.tv_sec && v->mtime_nsec == st->st_mtim.tv_nsec &&
+            v->ino == st->st_ino)
+            return 1;
+    }
+    return 0;
+}
+
+struct cache_entry *file_cache_lookup(const char *path, size_t len, unsigned int hash, long long now_ms) {
+    struct cache_shard *s = shard_for(hash);
+    struct cache_entry *e = find(s, path, len, hash);
+    if (!e) return NULL;
+    if (!__atomic_load_n(&e->referenced, __ATOMIC_RELAXED)) __atomic_store_n(&e->referenced, 1, __ATOMIC_RELAXED);
+
+    if (now_ms - __atomic_load_n(&e->checked_ms, __ATOMIC_RELAXED) >= FILE_CACHE_VALIDATE_MS) {
+        struct stat st;
+        int valid = stat(path, &st) == 0;
+        if (!valid || !same_version(&st, &e->st)) {
+            pthread_mutex_lock(&s->lock);
+            valid = valid && is_alias(e, &st);
+            if (!valid && e->linked) unlink_entry(s, e);
+            pthread_mutex_unlock(&s->lock);
+            if (!valid) return NULL;
+        }
+        __atomic_store_n(&e->checked_ms, now_ms, __ATOMIC_RELAXED);
+    }
+    return e;
+}
+
+void file_cache_share(struct cache_entry *e, const struct stat *st) {
+    struct cache_shard *s = shard_for(e->key.hash);
+    pthread_mutex_lock(&s->lock);
+    struct file_version *v = &e->aliases[e->alias_count++ % FILE_CACHE_ALIASES];
+    v->size = st->st_size;
+    v->mtime_sec = st->st_mtim.tv_sec;
+    v->mtime_nsec = st->st_mtim.tv_nsec;
+    v->ino = st->st_ino;
+    pthread_mutex_unlock(&s->lock);
+}
+
+void file_cache_remove(const char *path, size_t len, unsigned int hash) {
+    struct cache_shard *s = shard_for(hash);
+    pthread_mutex_lock(&s->lock);
+    struct cache_entry *e = find(s, path, len, hash);
+    if (e) unlink_entry(s, e);
+    pthread_mutex_unlock(&s->lock);
+}
+
+struct cache_entry *file_cache_insert(const char *path, size_t len, unsigned int hash, int fd, off_t offset,
+                                      const struct stat *st, long long now_ms) {
+    if (len > KEY_MAX_LEN) return NULL;
+    struct cache_entry *e = file_cache_load(fd, offset, st, now_ms);
+    return e ? file_cache_publish(e, path, len, hash) : NULL;
+}
+
+void file_cache_discard(struct cache_entry *e) {
+    free(e);
+}
+
+struct cache_entry *file_cache_load(int fd, off_t offset, const struct stat *st, long long now_ms) {
+    size_t size = st->st_size;
+    if (size > FILE_CACHE_MAX_OBJECT) return NULL;
+    struct cache_entry *e = (struct cache_entry *)malloc(sizeof(struct cache_entry) + size);
+    if (!e) return NULL;
+
+    size_t got = 0;
+    while (got < size) {
+        ssize_t n = pread(fd, e->data + got, size - got, offset + got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        got += n;
+    }
+    if (got != size) {
+        free(e);
+        return NULL;
+    }
+    e->st = *st;
+    e->size = size;
+    e->checked_ms = now_ms;
+    e->refs = 1;
+    e->linked = 1;
+    e->referenced = 0;
+    e->hits = 0;
+    e->alias_count = 0;
+    return e;
+}
+
+struct cache_entry *file_cache_publish(struct cache_entry *e, const char *path, size_t len, unsigned int hash) {
+    if (len > KEY_MAX_LEN) {
+        free(e);
+        return NULL;
+    }
+    size_t size = e->size;
+    struct cache_shard *s = shard_for(hash);
+    pthread_mutex_lock(&s->lock);
+    // A replaced entry hands its interned path on.
+    struct cache_entry *old = find(s, path, len, hash);
+    if (old) {
+        index_key_share(&e->key, &old->key);
+        unlink_entry(s, old);
+    } else if (index_key_intern(&s->index, &e->key, path, len, hash) < 0) {
+        pthread_mutex_unlock(&s->lock);
+        free(e);
+        return NULL;
+    }
+    // Evict until the shard is within its share of the budget.
+    while (s->hand && s->bytes + size > FILE_CACHE_BYTES / FILE_CACHE_SHARDS) {
+        struct cache_entry *victim = clock_victim(s);
+        if (evict_hook) evict_hook(victim);
+        unlink_entry(s, victim);
+    }
+    if (flat_index_insert(&s->index, &e->key) < 0) {
+        pthread_mutex_unlock(&s->lock);
+        index_key_release(&e->key);
+        free(e);
+        return NULL;
+    }
+    clock_insert(s, e);
+    s->bytes += size;
+    pthread_mutex_unlock(&s->lock);
+    return e;
+}
@@ -0,0 +1,114 @@
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include <stddef.h>
+#include <sys/stat.h>
+
+#include "ebr.h"
+#include "flat_index.h"
+
+/*
+ * Shared in-memory cache of small files, per process.
+ *
+ * Files up to FILE_CACHE_MAX_OBJECT bytes are read once and served from
+ * memory, with their stat data for the response header. The cache is
+ * split into FILE_CACHE_SHARDS shards and holds at most FILE_CACHE_BYTES in
+ * total. Each shard indexes its entries in a flat_index (flat_index.h),
+ * keyed by the path interned in the shard's arena. The path hash is
+ * computed by the caller, which can fold it into parsing the request with
+ * file_cache_hash_step().
+ *
+ * Lookups take no lock and write nothing but a CLOCK reference bit, and
+ * only when it is not already set. They run inside an EBR section (ebr.h),
+ * and the entry they return is valid until the section ends. Inserts and
+ * removals take the shard lock. A removed entry gives up the cache's
+ * reference only after a grace period. A connection that keeps an entry
+ * past its section takes a reference with file_cache_ref() first, and the
+ * last reference frees the entry.
+ *
+ * An entry is re-checked with stat() at most every FILE_CACHE_VALIDATE_MS,
+ * so a changed file is served from memory for up to that long. It also
+ * stays valid for up to FILE_CACHE_ALIASES other on-disk versions found to
+ * have the same bytes (file_cache_share()), such as the file in a new
+ * release of the document root. Removing any entry bumps
+ * file_cache_generation(); per-thread caches in front of this one
+ * (hot_cache.h) use it to notice.
+ */
+
+#define FILE_CACHE_SHARDS 16
+#define FILE_CACHE_MAX_OBJECT (256 * 1024)
+#define FILE_CACHE_BYTES (64 * 1024 * 1024)
+#define FILE_CACHE_VALIDATE_MS 1000
+#define FILE_CACHE_HASH_SEED 2166136261u    // FNV-1a
+#define FILE_CACHE_HIT_SLOTS 1024          // per-thread hit counts, direct-mapped by path hash
+#define FILE_CACHE_ALIASES 2
+
+struct file_version {
+    off_t size;
+    time_t mtime_sec;
+    long mtime_nsec;
+    ino_t ino;
+};
+
+struct cache_entry {
+    struct index_key key;       // the path; first, so the index's pointer is the entry's
+    struct cache_entry *clock_prev, *clock_next;    // ring swept by the shard's clock hand
+    struct ebr_node retired;
+    int refs;                   // the cache's, while indexed, plus one per holder
+    int linked;                 // still in the index
+    int referenced;             // CLOCK bit, set by lookups
+    unsigned int hits;          // as of the last file_cache_fold_hits()
+    long long checked_ms;       // last stat() that matched
+    struct stat st;             // of the version read, for response headers
+    struct file_version aliases[FILE_CACHE_ALIASES];    // under the shard lock
+    unsigned int alias_count;
+    size_t size;
+    char data[];
+};
+
+static inline unsigned int file_cache_hash_step(unsigned int h, char c) {
+    return (h ^ (unsigned char)c) * 16777619u;
+}
+
+unsigned int file_cache_hash(const char *path);
+
+// Must be called inside an EBR section. Entry for path (len bytes), or
+// NULL when it is not cached or has changed on disk (the stale entry is
+// dropped).
+struct cache_entry *file_cache_lookup(const char *path, size_t len, unsigned int hash, long long now_ms);
+// Inside an EBR section: read the open file fd (described by st) into a
+// new entry and index it. Returns NULL when the file is too big or cannot
+// be read.
+// The file's bytes start at offset in fd.
+struct cache_entry *file_cache_insert(const char *path, size_t len, unsigned int hash, int fd, off_t offset,
+                                      const struct stat *st, long long now_ms);
+// Read fd (as for file_cache_insert) into an entry that is not indexed
+// yet, to publish later or discard.
+struct cache_entry *file_cache_load(int fd, off_t offset, const struct stat *st, long long now_ms);
+// Inside an EBR section: index a loaded entry as path, replacing any entry
+// there. Returns NULL (and frees e) when it cannot.
+struct cache_entry *file_cache_publish(struct cache_entry *e, const char *path, size_t len, unsigned int hash);
+void file_cache_discard(struct cache_entry *e);
+// Inside an EBR section: drop path's entry, if any.
+void file_cache_remove(const char *path, size_t len, unsigned int hash);
+// Accept the file version st, which has e's bytes, as e's, replacing the
+// oldest alias.
+void file_cache_share(struct cache_entry *e, const struct stat *st);
+// Keep e beyond the current section (taken inside it); release when done.
+void file_cache_ref(struct cache_entry *e);
+void file_cache_release(struct cache_entry *e);
+unsigned long file_cache_generation(void);
+// Count a hit served from e in the calling thread's own table, so a hot
+// entry is not written from every core. Paths that share a slot replace
+// each other's counts.
+void file_cache_count_hit(struct cache_entry *e);
+// Add the hits counted since the last fold, in every thread, to the
+// entries' hits.
+void file_cache_fold_hits(void);
+// Call fn on every indexed entry, under each shard's lock in turn.
+void file_cache_for_each(void (*fn)(struct cache_entry *e, void *arg), void *arg);
+// Called with each entry the CLOCK evicts, under its shard lock, while the
+// cache still holds its reference.
+void file_cache_set_evict_hook(void (*hook)(struct cache_entry *e));
+
+#endif
@@ -0,0 +1,225 @@
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "flat_index.h"
+
+#define CTRL_EMPTY 0x80
+#define CTRL_DELETED 0xfe           // full slots hold 0..0x7f
+
+struct key_chunk {
+    int live;                       // keys cut from it, plus one while it is the arena's
+    char data[] __attribute__((aligned(8)));
+};
+
+// The string is kept next to the item pointer, so a probe compares keys
+// without going through the item.
+struct index_slot {
+    const unsigned int *key;        // length, then the interned string
+    struct index_key *item;
+};
+
+struct index_table {
+    struct ebr_node retired;
+    size_t mask;                    // capacity - 1
+    size_t used, deleted;
+    unsigned char *ctrl;
+    struct index_slot *slots;
+};
+
+// The callers' hash is cheap and weak in its high bits; this spreads it.
+static unsigned int mix(unsigned int h) {
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    return h ^ (h >> 16);
+}
+
+// Bit i set when control byte i of the group equals b.
+static unsigned int group_match(const unsigned char *ctrl, unsigned char b) {
+#ifdef __SSE2__
+    __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)b)));
+#else
+    unsigned int bits = 0;
+    for (int i = 0; i < FLAT_INDEX_GROUP; ++i) bits |= (unsigned int)(ctrl[i] == b) << i;
+    return bits;
+#endif
+}
+
+// Bit i set when slot i of the group is empty or deleted (high bit set).
+static unsigned int group_free(const unsigned char *ctrl) {
+#ifdef __SSE2__
+    return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+#else
+    unsigned int bits = 0;
+    for (int i = 0; i < FLAT_INDEX_GROUP; ++i) bits |= (unsigned int)(ctrl[i] >> 7) << i;
+    return bits;
+#endif
+}
+
+void flat_index_init(struct flat_index *ix) {
+    memset(ix, 0, sizeof(*ix));
+}
+
+static struct index_table *table_alloc(size_t capacity) {
+    struct index_table *t = (struct index_table *)malloc(sizeof(struct index_table) +
+                                                         capacity * (sizeof(struct index_slot) + 1));
+    if (!t) return NULL;
+    t->mask = capacity - 1;
+    t->used = t->deleted = 0;
+    t->slots = (struct index_slot *)(t + 1);
+    t->ctrl = (unsigned char *)(t->slots + capacity);
+    memset(t->slots, 0, capacity * sizeof(struct index_slot));
+    memset(t->ctrl, CTRL_EMPTY, capacity);
+    return t;
+}
+
+static void free_table(struct ebr_node *node) {
+    free(node);                     // 'retired' is the first member
+}
+
+// Readers may be probing t: the slot is written before its control byte.
+static void place(struct index_table *t, struct index_key *k) {
+    unsigned int m = mix(k->hash);
+    size_t groups_mask = t->mask / FLAT_INDEX_GROUP;
+    size_t g = m & groups_mask;
+    for (size_t step = 1;; ++step) {
+        unsigned char *ctrl = t->ctrl + g * FLAT_INDEX_GROUP;
+        unsigned int bits = group_free(ctrl);
+        if (bits) {
+            int i = __builtin_ctz(bits);
+            if (ctrl[i] == CTRL_DELETED) t->deleted--;
+            struct index_slot *slot = &t->slots[g * FLAT_INDEX_GROUP + i];
+            __atomic_store_n(&slot->item, k, __ATOMIC_RELEASE);
+            __atomic_store_n(&slot->key, (const unsigned int *)k->str - 1, __ATOMIC_RELEASE);
+            __atomic_store_n(&ctrl[i], (unsigned char)(m >> 25), __ATOMIC_RELEASE);
+            t->used++;
+            return;
+        }
+        g = (g + step) & groups_mask;
+    }
+}
+
+// Move the live keys into a table with room for 'need', at most 7/16 full.
+static struct index_table *rehash(struct flat_index *ix, size_t need) {
+    size_t capacity = FLAT_INDEX_MIN_CAPACITY;
+    while (need * 16 > capacity * 7) capacity *= 2;
+    struct index_table *t = table_alloc(capacity);
+    if (!t) return NULL;
+
+    struct index_table *old = ix->table;
+    if (old) {
+        for (size_t i = 0; i <= old->mask; ++i)
+            if (old->ctrl[i] < CTRL_EMPTY) place(t, old->slots[i].item);
+    }
+    __atomic_store_n(&ix->table, t, __ATOMIC_RELEASE);
+    if (old) ebr_retire(&old->retired, free_table);
+    return t;
+}
+
+void flat_index_destroy(struct flat_index *ix) {
+    free(ix->table);
+    if (ix->arena) {
+        struct index_key k = { NULL, 0, 0, ix->arena };
+        index_key_release(&k);
+    }
+    flat_index_init(ix);
+}
+
+struct index_key *flat_index_find(struct flat_index *ix, const char *str, size_t len, unsigned int hash) {
+    struct index_table *t = __atomic_load_n(&ix->table, __ATOMIC_ACQUIRE);
+    if (!t) return NULL;
+    unsigned int m = mix(hash);
+    size_t groups_mask = t->mask / FLAT_INDEX_GROUP;
+    size_t g = m & groups_mask;
+    for (size_t step = 1; step <= groups_mask + 1; ++step) {
+        const unsigned char *ctrl = t->ctrl + g * FLAT_INDEX_GROUP;
+        unsigned int bits = group_match(ctrl, (unsigned char)(m >> 25));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        for (; bits; bits &= bits - 1) {
+            struct index_slot *slot = &t->slots[g * FLAT_INDEX_GROUP + __builtin_ctz(bits)];
+            const unsigned int *key = __atomic_load_n(&slot->key, __ATOMIC_ACQUIRE);
+            if (!key || *key != len || memcmp(key + 1, str, len) != 0) continue;
+            // A slot being reused may pair the key with another item for a moment.
+            struct index_key *k = __atomic_load_n(&slot->item, __ATOMIC_ACQUIRE);
+            if ((const unsigned int *)k->str - 1 == key) return k;
+        }
+        if (group_match(ctrl, CTRL_EMPTY)) return NULL;
+        g = (g + step) & groups_mask;
+    }
+    return NULL;
+}
+
+int flat_index_insert(struct flat_index *ix, struct index_key *k) {
+    struct index_table *t = ix->table;
+    if (!t || (t->used + t->deleted + 1) * 8 > (t->mask + 1) * 7) {
+        t = rehash(ix, t ? t->used + 1 : 1);
+        if (!t) return -1;
+    }
+    place(t, k);
+    return 0;
+}
+
+void flat_index_remove(struct flat_index *ix, struct index_key *k) {
+    struct index_table *t = ix->table;
+    if (!t) return;
+    unsigned int m = mix(k->hash);
+    size_t groups_mask = t->mask / FLAT_INDEX_GROUP;
+    size_t g = m & groups_mask;
+    for (size_t step = 1; step <= groups_mask + 1; ++step) {
+        unsigned char *ctrl = t->ctrl + g * FLAT_INDEX_GROUP;
+        for (unsigned int bits = group_match(ctrl, (unsigned char)(m >> 25)); bits; bits &= bits - 1) {
+            int i = __builtin_ctz(bits);
+            if (t->slots[g * FLAT_INDEX_GROUP + i].item != k) continue;
+            // The slot keeps pointing at k, so a reader that saw the old byte still finds it.
+            __atomic_store_n(&ctrl[i], (unsigned char)CTRL_DELETED, __ATOMIC_RELEASE);
+            t->used--;
+            t->deleted++;
+            return;
+        }
+        if (group_match(ctrl, CTRL_EMPTY)) return;
+        g = (g + step) & groups_mask;
+    }
+}
+
+int index_key_intern(struct flat_index *ix, struct index_key *k, const char *str, size_t len, unsigned int hash) {
+    if (len > KEY_MAX_LEN) return -1;
+    // The length, the string and its NUL, padded to keep lengths aligned.
+    size_t need = (sizeof(unsigned int) + len + 1 + sizeof(unsigned int) - 1) & ~(sizeof(unsigned int) - 1);
+    if (!ix->arena || ix->arena_used + need > KEY_ARENA_CHUNK) {
+        struct key_chunk *chunk = (struct key_chunk *)malloc(sizeof(struct key_chunk) + KEY_ARENA_CHUNK);
+        if (!chunk) return -1;
+        chunk->live = 1;
+        if (ix->arena) {
+            struct index_key old = { NULL, 0, 0, ix->arena };
+            index_key_release(&old);
+        }
+        ix->arena = chunk;
+        ix->arena_used = 0;
+    }
+    unsigned int *record = (unsigned int *)(ix->arena->data + ix->arena_used);
+    *record = len;
+    char *s = (char *)(record + 1);
+    memcpy(s, str, len);
+    s[len] = '\0';
+    ix->arena_used += need;
+    __atomic_fetch_add(&ix->arena->live, 1, __ATOMIC_RELAXED);
+    k->str = s;
+    k->len = len;
+    k->hash = hash;
+    k->chunk = ix->arena;
+    return 0;
+}
+
+void index_key_share(struct index_key *k, const struct index_key *from) {
+    *k = *from;
+    __atomic_fetch_add(&k->chunk->live, 1, __ATOMIC_RELAXED);
+}
+
+void index_key_release(struct index_key *k) {
+    if (__atomic_sub_fetch(&k->chunk->live, 1, __ATOMIC_ACQ_REL) == 0) free(k->chunk);
+}
@@ -0,0 +1,71 @@
+#ifndef FLAT_INDEX_H
+#define FLAT_INDEX_H
+
+#include <stddef.h>
+
+#include "ebr.h"
+
+/*
+ * Open-addressing hash index from interned string keys to items.
+ *
+ * The layout is a Swiss table. Each slot has a control byte that holds
+ * 7 bits of the mixed hash when full, or marks the slot empty or deleted.
+ * Slots are probed in aligned groups of FLAT_INDEX_GROUP, visited in
+ * triangular order. One SSE2 compare matches a whole group's control
+ * bytes, so a lookup follows a slot to its key only when those 7 bits
+ * agree, which is 1 in 128 for a wrong key. A probe stops at the first
+ * group with an empty slot.
+ *
+ * Keys are interned. The string is stored once, in the index's arena of
+ * KEY_ARENA_CHUNK blocks, and items embed a struct index_key that points
+ * at it along with its length and hash. The hash is computed by the
+ * caller, which can do it while parsing the request. A chunk is freed
+ * when the last key cut from it is released.
+ *
+ * Lookups take no lock and must run inside an EBR section (ebr.h). Writers
+ * are serialized by the caller. A removed slot becomes a tombstone. When
+ * full and deleted slots pass 7/8 of the table, the writer builds a new
+ * table sized for the live keys, publishes it, and retires the old one.
+ */
+
+#define FLAT_INDEX_GROUP 16
+#define FLAT_INDEX_MIN_CAPACITY 16
+#define KEY_ARENA_CHUNK (64 * 1024)
+#define KEY_MAX_LEN 4095
+
+struct key_chunk;
+struct index_table;
+
+struct index_key {
+    const char *str;                // NUL-terminated, in a key_chunk
+    unsigned int len;
+    unsigned int hash;
+    struct key_chunk *chunk;
+};
+
+struct flat_index {
+    struct index_table *table;      // NULL until the first insert
+    struct key_chunk *arena;        // chunk new keys are cut from
+    size_t arena_used;
+};
+
+void flat_index_init(struct flat_index *ix);
+// Free the table. Keys still interned keep their chunks until released.
+void flat_index_destroy(struct flat_index *ix);
+// Inside an EBR section: the indexed key equal to str, or NULL.
+struct index_key *flat_index_find(struct flat_index *ix, const char *str, size_t len, unsigned int hash);
+// Writer: index k, whose key must not be indexed yet. -1 when out of memory.
+int flat_index_insert(struct flat_index *ix, struct index_key *k);
+// Writer: take k out of the index. Readers may still find it until their
+// section ends.
+void flat_index_remove(struct flat_index *ix, struct index_key *k);
+
+// Writer: copy str into the arena as k's key. -1 when it is longer than
+// KEY_MAX_LEN or out of memory.
+int index_key_intern(struct flat_index *ix, struct index_key *k, const char *str, size_t len, unsigned int hash);
+// Writer: make k share from's string instead of copying it again.
+void index_key_share(struct index_key *k, const struct index_key *from);
+// Any thread: k's item is gone.
+void index_key_release(struct index_key *k);
+
+#endif
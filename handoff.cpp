@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "handoff.h"
+#include "file_cache.h"
+#include "server_core.h"
+
+#define HANDOFF_FDS 3               // listening socket, arena, index
+#define HANDOFF_ACK_TIMEOUT_S 30
+
+static const char *socket_path;
+static int handoff_listener = -1;
+static int listen_socket = -1;
+
+struct entry_list {
+    struct cache_entry **entries;
+    size_t count, cap;
+};
+
+static int fill_address(struct sockaddr_un *addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr->sun_path)) return -1;
+    strcpy(addr->sun_path, socket_path);
+    return 0;
+}
+
+static int write_all(int fd, const void *buf, size_t len) {
+    const char *p = (const char *)buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// Under the shard lock the entry is indexed, so the cache's reference
+// keeps it alive while we take ours.
+static void take(struct cache_entry *e, void *arg) {
+    struct entry_list *list = (struct entry_list *)arg;
+    if (list->count == list->cap) {
+        size_t cap = list->cap ? list->cap * 2 : 1024;
+        struct cache_entry **entries =
+            (struct cache_entry **)realloc(list->entries, cap * sizeof(struct cache_entry *));
+        if (!entries) return;
+        list->entries = entries;
+        list->cap = cap;
+    }
+    file_cache_ref(e);
+    list->entries[list->count++] = e;
+}
+
+static int export_cache(int arena, int index, struct handoff_header *header) {
+    struct entry_list list = { NULL, 0, 0 };
+    file_cache_for_each(take, &list);
+    int ret = 0;
+    for (size_t i = 0; i < list.count; ++i) {
+        struct cache_entry *e = list.entries[i];
+        struct handoff_record record;
+        memset(&record, 0, sizeof(record));
+        record.offset = header->arena_bytes;
+        record.hits = __atomic_load_n(&e->hits, __ATOMIC_RELAXED);
+        record.len = e->key.len;
+        record.st = e->st;
+        if (ret == 0 && (write_all(arena, e->data, e->size) < 0 || write_all(index, &record, sizeof(record)) < 0 ||
+                         write_all(index, e->key.str, e->key.len) < 0))
+            ret = -1;
+        header->arena_bytes += e->size;
+        header->count++;
+        file_cache_release(e);
+    }
+    free(list.entries);
+    return ret;
+}
+
+static int send_handoff(int peer, const struct handoff_header *header, const int *fds) {
+    struct iovec iov = { (void *)header, sizeof(*header) };
+    char control[CMSG_SPACE(HANDOFF_FDS * sizeof(int))];
+    memset(control, 0, sizeof(control));
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(HANDOFF_FDS * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, HANDOFF_FDS * sizeof(int));
+    return sendmsg(peer, &msg, MSG_NOSIGNAL) == (ssize_t)sizeof(*header) ? 0 : -1;
+}
+
+// 0 once the successor has loaded everything and acked.
+static int hand_over(int peer) {
+    long long start = monotonic_ms();
+    int arena = memfd_create("handoff-arena", MFD_CLOEXEC);
+    int index = memfd_create("handoff-index", MFD_CLOEXEC);
+    struct handoff_header header = { HANDOFF_MAGIC, 0, 0 };
+    int ret = -1;
+    if (arena >= 0 && index >= 0 && export_cache(arena, index, &header) == 0) {
+        int fds[HANDOFF_FDS] = { listen_socket, arena, index };
+        struct timeval timeout = { HANDOFF_ACK_TIMEOUT_S, 0 };
+        setsockopt(peer, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        char ack;
+        if (send_handoff(peer, &header, fds) == 0 && recv(peer, &ack, 1, 0) == 1) ret = 0;
+    }
+    if (arena >= 0) close(arena);
+    if (index >= 0) close(index);
+    if (ret == 0)
+        fprintf(stderr, "[%d] handoff: sent %u files, %llu bytes in %lld ms\n", (int)getpid(), header.count,
+                (unsigned long long)header.arena_bytes, monotonic_ms() - start);
+    return ret;
+}
+
+static void *serve_handoffs(void *arg) {
+    (void)arg;
+    while (1) {
+        int peer = accept4(handoff_listener, NULL, NULL, SOCK_CLOEXEC);
+        if (peer < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            log_error("handoff accept failed", 0);
+            return NULL;
+        }
+        int done = hand_over(peer) == 0;
+        if (!done) log_error("handoff failed", 0);
+        close(peer);
+        if (done) break;
+    }
+    close(handoff_listener);
+    server_handoff_shutdown();
+    return NULL;
+}
+
+static int receive_handoff(int sock, struct handoff_header *header, int *fds) {
+    struct iovec iov = { header, sizeof(*header) };
+    char control[CMSG_SPACE(HANDOFF_FDS * sizeof(int))];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t n;
+    do {
+        n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC | MSG_WAITALL);
+    } while (n < 0 && errno == EINTR);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(HANDOFF_FDS * sizeof(int)))
+        return -1;
+    memcpy(fds, CMSG_DATA(cmsg), HANDOFF_FDS * sizeof(int));
+    if (n != (ssize_t)sizeof(*header) || header->magic != HANDOFF_MAGIC) {
+        for (int i = 0; i < HANDOFF_FDS; ++i) close(fds[i]);
+        return -1;
+    }
+    return 0;
+}
+
+// Load every record, reading the bodies from the arena.
+static void import_cache(int arena, int index, const struct handoff_header *header) {
+    struct stat st;
+    if (header->count == 0 || fstat(index, &st) < 0 || st.st_size == 0) return;
+    const char *base = (const char *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, index, 0);
+    if (base == MAP_FAILED) {
+        log_error("handoff index mmap failed", 0);
+        return;
+    }
+    const char *p = base, *end = base + st.st_size;
+    long long now = monotonic_ms();
+    if (ebr_enter() == 0) {
+        for (uint32_t i = 0; i < header->count && end - p >= (ptrdiff_t)sizeof(struct handoff_record); ++i) {
+            struct handoff_record record;
+            memcpy(&record, p, sizeof(record));
+            p += sizeof(record);
+            if (record.len > (size_t)(end - p) || record.len > KEY_MAX_LEN) break;
+            char path[KEY_MAX_LEN + 1];
+            memcpy(path, p, record.len);
+            path[record.len] = '\0';
+            p += record.len;
+            struct cache_entry *e = file_cache_insert(path, record.len, file_cache_hash(path), arena,
+                                                      record.offset, &record.st, now);
+            if (e) __atomic_store_n(&e->hits, record.hits, __ATOMIC_RELAXED);
+        }
+        ebr_exit();
+    }
+    munmap((void *)base, st.st_size);
+}
+
+void handoff_configure(const char *path) {
+    socket_path = path;
+}
+
+int handoff_receive(void) {
+    struct sockaddr_un addr;
+    if (!socket_path || fill_address(&addr) < 0) return -1;
+    int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock < 0) return -1;
+    // Nobody there: a plain start.
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(sock);
+        return -1;
+    }
+
+    long long start = monotonic_ms();
+    struct handoff_header header;
+    int fds[HANDOFF_FDS];
+    if (receive_handoff(sock, &header, fds) < 0) {
+        log_error("handoff receive failed", 0);
+        close(sock);
+        return -1;
+    }
+    import_cache(fds[1], fds[2], &header);
+    close(fds[1]);
+    close(fds[2]);
+    char ack = 1;
+    if (send(sock, &ack, 1, MSG_NOSIGNAL) != 1) log_error("handoff ack failed", 0);
+    close(sock);
+    fprintf(stderr, "[%d] handoff: took over %u files, %llu bytes in %lld ms\n", (int)getpid(), header.count,
+            (unsigned long long)header.arena_bytes, monotonic_ms() - start);
+    return fds[0];
+}
+
+int handoff_start(int server_fd) {
+    struct sockaddr_un addr;
+    if (!socket_path || handoff_listener >= 0) return 0;
+    if (fill_address(&addr) < 0) return -1;
+    int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock < 0) return -1;
+    // A predecessor's socket file, live or stale, gives way to ours.
+    unlink(socket_path);
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(sock, 1) < 0) {
+        close(sock);
+        return -1;
+    }
+    handoff_listener = sock;
+    listen_socket = server_fd;
+    if (start_background_thread(serve_handoffs, NULL) < 0) {
+        close(sock);
+        handoff_listener = -1;
+        return -1;
+    }
+    return 0;
+}
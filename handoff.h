@@ -0,0 +1,53 @@
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+/*
+ * Handoff of the listening socket and the memory cache to a new server
+ * binary, so an upgrade starts warm.
+ *
+ * A serving process with a handoff path listens on a unix socket there.
+ * A new process started with the same path connects to it before binding.
+ * The old process then copies every memory-tier entry (file_cache.h) into
+ * two memfds:
+ *   - the arena, which holds the bodies back to back;
+ *   - the index, a struct handoff_record per entry followed by its path.
+ * It sends both, together with its listening socket, in one SCM_RIGHTS
+ * message headed by a struct handoff_header. The new process loads the
+ * entries from the arena, so it reads nothing from the document root. It
+ * keeps each entry's stat data and hit count. It acks with one byte and
+ * then binds the handoff path for its own successor. On the ack, the old
+ * process stops as on SIGTERM but leaves the shared listening socket open.
+ *
+ * Handoffs are served by backends whose cache lives in the process that
+ * called server_run(): thread, pool, epoll and io_uring. A new process of
+ * any backend can take over from them. The spill tier is not handed over.
+ */
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+#define HANDOFF_MAGIC 0x46464f48u       // "HOFF"
+
+struct handoff_header {
+    uint32_t magic;
+    uint32_t count;         // records in the index
+    uint64_t arena_bytes;
+};
+
+struct handoff_record {
+    uint64_t offset;        // of the body in the arena; its size is st.st_size
+    uint32_t hits;
+    uint32_t len;           // path bytes after the record, no NUL
+    struct stat st;
+};
+
+// Record the unix socket path in this process; NULL leaves handoff off.
+void handoff_configure(const char *path);
+// Before binding: take over from the server at the handoff path. Returns
+// its listening socket with the cache loaded, or -1 when no server answers.
+int handoff_receive(void);
+// In the serving process: wait for a successor at the handoff path and
+// hand it server_fd.
+int handoff_start(int server_fd);
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef HEADER_BUILDER_H
+#define HEADER_BUILDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Append-only response header builder over a caller-provided buffer,
+ * replacing snprintf for dynamic headers. Integers are emitted two digits
+ * per step from a 200-byte table. Appends past the end set 'overflow' and
+ * are dropped; hb_finish() then returns 0.
+ */
+
+struct header_builder {
+    char *buf;
+    size_t len, cap;
+    int overflow;
+};
+
+extern const char digit_pairs[200];
+
+static inline unsigned int u64_digit_count(uint64_t v) {
+    unsigned int n = 1;
+    for (;;) {
+        if (v < 10) return n;
+        if (v < 100) return n + 1;
+        if (v < 1000) return n + 2;
+        if (v < 10000) return n + 3;
+        v /= 10000;
+        n += 4;
+    }
+}
+
+// Write v in decimal at dst (no terminator); returns the end.
+static inline char *u64_to_ascii(char *dst, uint64_t v) {
+    unsigned int n = u64_digit_count(v);
+    char *p = dst + n;
+    while (v >= 100) {
+        unsigned int i = (unsigned int)(v % 100) * 2;
+        v /= 100;
+        p -= 2;
+        memcpy(p, digit_pairs + i, 2);
+    }
+    if (v >= 10) {
+        p -= 2;
+        memcpy(p, digit_pairs + v * 2, 2);
+    } else {
+        *--p = (char)('0' + v);
+    }
+    return dst + n;
+}
+
+static inline void hb_init(struct header_builder *b, char *buf, size_t cap) {
+    b->buf = buf;
+    b->len = 0;
+    b->cap = cap;
+    b->overflow = 0;
+}
+
+static inline void hb_append(struct header_builder *b, const char *s, size_t n) {
+    if (b->len + n > b->cap) {
+        b->overflow = 1;
+        return;
+    }
+    memcpy(b->buf + b->len, s, n);
+    b->len += n;
+}
+
+static inline void hb_append_str(struct header_builder *b, const char *s) {
+    hb_append(b, s, strlen(s));
+}
+
+static inline void hb_append_uint(struct header_builder *b, uint64_t v) {
+    if (b->len + 20 > b->cap && b->len + u64_digit_count(v) > b->cap) {
+        b->overflow = 1;
+        return;
+    }
+    b->len = u64_to_ascii(b->buf + b->len, v) - b->buf;
+}
+
+// Lowercase hex, zero-padded to at least min_digits.
+static inline void hb_append_hex(struct header_builder *b, uint64_t v, unsigned int min_digits) {
+    char digits[16];
+    unsigned int n = 0;
+    do {
+        digits[15 - n++] = "0123456789abcdef"[v & 15];
+        v >>= 4;
+    } while (v || n < min_digits);
+    hb_append(b, digits + 16 - n, n);
+}
+
+// Append "name: value\r\n".
+static inline void hb_append_header(struct header_builder *b, const char *name, const char *value) {
+    hb_append_str(b, name);
+    hb_append(b, ": ", 2);
+    hb_append_str(b, value);
+    hb_append(b, "\r\n", 2);
+}
+
+// Length of the built header, or 0 if anything did not fit.
+static inline size_t hb_finish(struct header_builder *b) {
+    return b->overflow ? 0 : b->len;
+}
+
+#endif
@@ -0,0 +1,118 @@
+#include <string.h>
+
+#include "hot_cache.h"
+
+struct hot_candidate {
+    unsigned int hash;
+    unsigned int hits;
+};
+
+struct hot_cache {
+    int enabled;
+    unsigned long generation;
+    unsigned int lookups;
+    struct hot_slot slots[HOT_CACHE_SLOTS];
+    struct hot_candidate candidates[HOT_CACHE_CANDIDATES];
+};
+
+static __thread struct hot_cache hot;
+
+static void clear_slot(struct hot_slot *slot) {
+    file_cache_release(slot->entry);
+    memset(slot, 0, sizeof(*slot));
+}
+
+static void retire_slot(struct hot_slot *slot) {
+    if (slot->borrowed == 0) clear_slot(slot);
+    else slot->retired = 1;
+}
+
+void hot_cache_enable(void) {
+    memset(&hot, 0, sizeof(hot));
+    hot.generation = file_cache_generation();
+    hot.enabled = 1;
+}
+
+void hot_cache_disable(void) {
+    for (int i = 0; i < HOT_CACHE_SLOTS; ++i) {
+        if (hot.slots[i].entry && !hot.slots[i].retired) retire_slot(&hot.slots[i]);
+    }
+    hot.enabled = 0;
+}
+
+// Something left the shared index since we last looked: retire what we hold of it.
+static void catch_up(unsigned long generation) {
+    for (int i = 0; i < HOT_CACHE_SLOTS; ++i) {
+        struct hot_slot *slot = &hot.slots[i];
+        if (slot->entry && !slot->retired && !__atomic_load_n(&slot->entry->linked, __ATOMIC_ACQUIRE))
+            retire_slot(slot);
+    }
+    hot.generation = generation;
+}
+
+static void decay(void) {
+    for (int i = 0; i < HOT_CACHE_SLOTS; ++i) hot.slots[i].hits >>= 1;
+    for (int i = 0; i < HOT_CACHE_CANDIDATES; ++i) hot.candidates[i].hits >>= 1;
+}
+
+struct hot_slot *hot_cache_lookup(const char *path, size_t len, unsigned int hash, long long now_ms) {
+    if (!hot.enabled) return NULL;
+    unsigned long generation = file_cache_generation();
+    if (generation != hot.generation) catch_up(generation);
+    if (++hot.lookups % HOT_CACHE_DECAY_LOOKUPS == 0) decay();
+
+    for (int i = 0; i < HOT_CACHE_SLOTS; ++i) {
+        struct hot_slot *slot = &hot.slots[i];
+        if (!slot->entry || slot->retired || slot->hash != hash || slot->entry->key.len != len ||
+            memcmp(slot->entry->key.str, path, len) != 0)
+            continue;
+        // Due for a stat(): let the shared cache check it.
+        if (now_ms - __atomic_load_n(&slot->entry->checked_ms, __ATOMIC_RELAXED) >= FILE_CACHE_VALIDATE_MS)
+            return NULL;
+        slot->hits++;
+        slot->borrowed++;
+        return slot;
+    }
+    return NULL;
+}
+
+void hot_cache_offer(struct cache_entry *e) {
+    if (!hot.enabled) return;
+    struct hot_candidate *cand = &hot.candidates[e->key.hash % HOT_CACHE_CANDIDATES];
+    if (cand->hash != e->key.hash) {
+        cand->hash = e->key.hash;
+        cand->hits = 0;
+    }
+    if (++cand->hits < HOT_CACHE_ADMIT_HITS) return;
+
+    // A free slot, else the coldest one nobody is borrowing, if colder than this path.
+    struct hot_slot *victim = NULL;
+    for (int i = 0; i < HOT_CACHE_SLOTS; ++i) {
+        struct hot_slot *slot = &hot.slots[i];
+        if (slot->entry == e && !slot->retired) return;
+        if (!slot->entry) {
+            if (!victim || victim->entry) victim = slot;
+        } else if (!slot->borrowed && !slot->retired && (!victim || (victim->entry && slot->hits < victim->hits))) {
+            victim = slot;
+        }
+    }
+    if (!victim || (victim->entry && victim->hits >= cand->hits)) return;
+    if (victim->entry) clear_slot(victim);
+
+    file_cache_ref(e);
+    victim->entry = e;
+    victim->hash = e->key.hash;
+    victim->hits = cand->hits;
+    cand->hits = 0;
+}
+
+void hot_cache_return(struct hot_slot *slot) {
+    if (--slot->borrowed == 0 && slot->retired) clear_slot(slot);
+}
+
+struct cache_entry *hot_cache_detach(struct hot_slot *slot) {
+    struct cache_entry *e = slot->entry;
+    file_cache_ref(e);
+    hot_cache_return(slot);
+    return e;
+}
@@ -0,0 +1,50 @@
+#ifndef HOT_CACHE_H
+#define HOT_CACHE_H
+
+#include "file_cache.h"
+
+/*
+ * Per-thread micro-cache in front of the shared file cache.
+ *
+ * A serving thread that enables it keeps its own reference to the
+ * HOT_CACHE_SLOTS entries it hits most. A hit there touches only
+ * thread-local state: no shard lock, no refcount and no LRU update. Paths
+ * are admitted after HOT_CACHE_ADMIT_HITS shared-cache hits. Counts halve
+ * every HOT_CACHE_DECAY_LOOKUPS lookups, so the slots follow the current
+ * top K.
+ *
+ * Invalidation is by epoch. Each thread remembers file_cache_generation(),
+ * and only when it has moved does it look for slots whose entry left the
+ * shared index. A slot that connections of this thread still serve from is
+ * retired and let go when the last of them is done. Connections handed to
+ * another thread must trade their borrow for a real reference first
+ * (hot_cache_detach).
+ */
+
+#define HOT_CACHE_SLOTS 16
+#define HOT_CACHE_CANDIDATES 64
+#define HOT_CACHE_ADMIT_HITS 8
+#define HOT_CACHE_DECAY_LOOKUPS 1024
+
+struct hot_slot {
+    struct cache_entry *entry;      // NULL when free
+    unsigned int hash;
+    unsigned int hits;
+    int borrowed;                   // connections of this thread using entry
+    int retired;                    // no longer served; freed at borrowed == 0
+};
+
+// Turn the cache on for the calling thread; off again releases its references.
+void hot_cache_enable(void);
+void hot_cache_disable(void);
+
+// Slot with a fresh entry for path, borrowed by the caller, or NULL.
+struct hot_slot *hot_cache_lookup(const char *path, size_t len, unsigned int hash, long long now_ms);
+// Count a shared-cache hit on e, admitting it once it is hot.
+void hot_cache_offer(struct cache_entry *e);
+// End a borrow from hot_cache_lookup().
+void hot_cache_return(struct hot_slot *slot);
+// End a borrow but keep the entry, with a reference of the caller's own.
+struct cache_entry *hot_cache_detach(struct hot_slot *slot);
+
+#endif
@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "hot_set.h"
+#include "file_cache.h"
+#include "server_core.h"
+
+struct hot_path {
+    unsigned int hits;
+    unsigned short len;
+    char *path;
+};
+
+struct hot_list {
+    struct hot_path *paths;
+    size_t count, cap;
+};
+
+static const char *snapshot_path;
+static pid_t running_pid;         // the process the threads run in
+static pthread_mutex_t start_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t save_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// The prefetch threads take paths in order from next.
+static struct hot_list loaded;
+static size_t next_path;
+static pthread_mutex_t prefetch_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int add_path(struct hot_list *list, const char *path, size_t len, unsigned int hits) {
+    if (list->count == list->cap) {
+        size_t cap = list->cap ? list->cap * 2 : 256;
+        struct hot_path *paths = (struct hot_path *)realloc(list->paths, cap * sizeof(struct hot_path));
+        if (!paths) return -1;
+        list->paths = paths;
+        list->cap = cap;
+    }
+    char *copy = (char *)malloc(len + 1);
+    if (!copy) return -1;
+    memcpy(copy, path, len);
+    copy[len] = '\0';
+    list->paths[list->count].hits = hits;
+    list->paths[list->count].len = len;
+    list->paths[list->count].path = copy;
+    list->count++;
+    return 0;
+}
+
+static void free_list(struct hot_list *list) {
+    for (size_t i = 0; i < list->count; ++i) free(list->paths[i].path);
+    free(list->paths);
+    memset(list, 0, sizeof(*list));
+}
+
+static int by_hits(const void *a, const void *b) {
+    unsigned int x = ((const struct hot_path *)a)->hits, y = ((const struct hot_path *)b)->hits;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+// Under the shard lock: take the entry's count and halve it.
+static void collect(struct cache_entry *e, void *arg) {
+    unsigned int hits = __atomic_load_n(&e->hits, __ATOMIC_RELAXED);
+    __atomic_store_n(&e->hits, hits / 2, __ATOMIC_RELAXED);
+    if (e->key.len <= 0xffff) add_path((struct hot_list *)arg, e->key.str, e->key.len, hits);
+}
+
+static int write_snapshot(const struct hot_list *list) {
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.%d.tmp", snapshot_path, (int)getpid());
+    FILE *f = fopen(tmp, "wb");
+    if (!f) return -1;
+    size_t count = list->count < HOT_SET_MAX_PATHS ? list->count : HOT_SET_MAX_PATHS;
+    struct hot_set_header header = { HOT_SET_MAGIC, (uint32_t)count };
+    int ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    for (size_t i = 0; ok && i < count; ++i) {
+        uint32_t hits = list->paths[i].hits;
+        uint16_t len = list->paths[i].len;
+        ok = fwrite(&hits, sizeof(hits), 1, f) == 1 && fwrite(&len, sizeof(len), 1, f) == 1 &&
+             fwrite(list->paths[i].path, 1, len, f) == len;
+    }
+    if (fclose(f) != 0) ok = 0;
+    if (!ok || rename(tmp, snapshot_path) < 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+int hot_set_save(void) {
+    if (__atomic_load_n(&running_pid, __ATOMIC_ACQUIRE) != getpid()) return 0;
+    pthread_mutex_lock(&save_lock);
+    struct hot_list list = { NULL, 0, 0 };
+    file_cache_fold_hits();
+    file_cache_for_each(collect, &list);
+    qsort(list.paths, list.count, sizeof(struct hot_path), by_hits);
+    int ret = write_snapshot(&list);
+    free_list(&list);
+    pthread_mutex_unlock(&save_lock);
+    return ret;
+}
+
+static int read_snapshot(struct hot_list *list) {
+    FILE *f = fopen(snapshot_path, "rb");
+    if (!f) return errno == ENOENT ? 0 : -1;
+    struct hot_set_header header;
+    int ok = fread(&header, sizeof(header), 1, f) == 1 && header.magic == HOT_SET_MAGIC &&
+             header.count <= HOT_SET_MAX_PATHS;
+    char path[0x10000];
+    for (uint32_t i = 0; ok && i < header.count; ++i) {
+        uint32_t hits;
+        uint16_t len;
+        ok = fread(&hits, sizeof(hits), 1, f) == 1 && fread(&len, sizeof(len), 1, f) == 1 &&
+             fread(path, 1, len, f) == len && add_path(list, path, len, hits) == 0;
+    }
+    fclose(f);
+    return ok ? 0 : -1;
+}
+
+static void *prefetch_worker(void *arg) {
+    (void)arg;
+    while (1) {
+        pthread_mutex_lock(&prefetch_lock);
+        size_t i = next_path++;
+        pthread_mutex_unlock(&prefetch_lock);
+        if (i >= loaded.count) break;
+
+        struct hot_path *p = &loaded.paths[i];
+        unsigned int hash = file_cache_hash(p->path);
+        int cached = 0;
+        if (ebr_enter() == 0) {
+            cached = file_cache_lookup(p->path, p->len, hash, monotonic_ms()) != NULL;
+            ebr_exit();
+        }
+        if (cached) continue;       // already requested since startup
+        int fd = open(p->path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) continue;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && ebr_enter() == 0) {
+            struct cache_entry *e = file_cache_insert(p->path, p->len, hash, fd, 0, &st, monotonic_ms());
+            if (e) __atomic_store_n(&e->hits, p->hits, __ATOMIC_RELAXED);
+            ebr_exit();
+        }
+        close(fd);
+    }
+    return NULL;
+}
+
+// Hints for every file first, so the reads overlap, then the cache loads.
+static void *prefetch(void *arg) {
+    (void)arg;
+    size_t budget = FILE_CACHE_BYTES;
+    size_t count = 0;
+    for (; count < loaded.count; ++count) {
+        int fd = open(loaded.paths[count].path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) continue;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && (size_t)st.st_size <= FILE_CACHE_MAX_OBJECT) {
+            posix_fadvise(fd, 0, st.st_size, POSIX_FADV_WILLNEED);
+            budget = (size_t)st.st_size < budget ? budget - st.st_size : 0;
+        }
+        close(fd);
+        if (budget == 0) break;
+    }
+    loaded.count = count;
+
+    long long start = monotonic_ms();
+    pthread_t tids[HOT_SET_PREFETCH_THREADS];
+    int started = 0;
+    // Workers inherit this thread's mask, with every signal blocked.
+    for (; started < HOT_SET_PREFETCH_THREADS; ++started)
+        if (pthread_create(&tids[started], NULL, prefetch_worker, NULL) != 0) break;
+    for (int i = 0; i < started; ++i) pthread_join(tids[i], NULL);
+    fprintf(stderr, "[%d] hot set: %zu files prefetched in %lld ms\n", (int)getpid(), count,
+            monotonic_ms() - start);
+    return NULL;
+}
+
+static void *save_loop(void *arg) {
+    (void)arg;
+    while (1) {
+        sleep(HOT_SET_INTERVAL_S);
+        if (hot_set_save() < 0) log_error("hot set save failed", 0);
+    }
+    return NULL;
+}
+
+void hot_set_configure(const char *path) {
+    snapshot_path = path;
+}
+
+int hot_set_start(void) {
+    if (!snapshot_path) return 0;
+    pthread_mutex_lock(&start_lock);
+    int ret = 0;
+    // A forked child inherits running_pid but not the threads; it reads
+    // the snapshot again and prefetches into its own cache.
+    if (running_pid != getpid()) {
+        free_list(&loaded);
+        next_path = 0;
+        if (read_snapshot(&loaded) < 0) {
+            log_error("hot set snapshot unreadable, starting cold", 0);
+            free_list(&loaded);
+        }
+        if ((loaded.count > 0 && start_background_thread(prefetch, NULL) < 0) ||
+            start_background_thread(save_loop, NULL) < 0)
+            ret = -1;
+        else
+            __atomic_store_n(&running_pid, getpid(), __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&start_lock);
+    return ret;
+}
@@ -0,0 +1,45 @@
+#ifndef HOT_SET_H
+#define HOT_SET_H
+
+/*
+ * Snapshot of the memory tier's hot set, for warm restarts.
+ *
+ * Cache hits are counted per thread, and hot_set_save() first folds them
+ * into the entries (file_cache.h). It writes the HOT_SET_MAX_PATHS
+ * most-hit paths and their counts to a small binary file, replaced with
+ * rename(). It then halves the counts, so the snapshot follows recent
+ * traffic. A background thread saves every HOT_SET_INTERVAL_S, and the
+ * serving process saves once more at shutdown. With several worker
+ * processes the last one to save wins.
+ *
+ * hot_set_start() reads the previous snapshot and warms the process up in
+ * the background while it already serves:
+ *   - posix_fadvise(WILLNEED) on every file, so the kernel reads them in
+ *     parallel;
+ *   - then HOT_SET_PREFETCH_THREADS threads load them into the memory
+ *     tier with their old counts, hottest first, up to its budget.
+ *
+ * File layout: struct hot_set_header, then per path its hit count
+ * (uint32), its length (uint16) and its bytes, with no NUL.
+ */
+
+#include <stdint.h>
+
+#define HOT_SET_MAGIC 0x31544553u       // "SET1"
+#define HOT_SET_MAX_PATHS 8192
+#define HOT_SET_INTERVAL_S 60
+#define HOT_SET_PREFETCH_THREADS 8
+
+struct hot_set_header {
+    uint32_t magic;
+    uint32_t count;
+};
+
+// Record the snapshot file for hot_set_start(); NULL leaves it off.
+void hot_set_configure(const char *path);
+// Once per serving process: start the prefetch and the periodic saves.
+int hot_set_start(void);
+// Write the snapshot now; does nothing in a process that did not start it.
+int hot_set_save(void);
+
+#endif
@@ -0,0 +1,108 @@
+#!/bin/bash
+
+## Time to steady-state p99 after a restart, with and without the hot-set
+## snapshot (SERVER_HOT_SET, see hot_set.h). A warm run over FILES files with
+## a skewed request mix measures the steady p99 and saves the snapshot. The
+## files are then dropped from the page cache and the server restarted,
+## once cold and once prefetching the snapshot. Requests go out from CONC
+## sequential curl loops; p99 is taken per window of WINDOW requests, and the
+## report gives the first window within 1.25x of the warm p99, with the
+## elapsed time to reach it. Writes hotset_report.txt.
+
+src=$(dirname "$(readlink -f "$0")")
+port=${port:-18980}
+FILES=${FILES:-1000}
+SIZE=${SIZE:-32768}
+REQUESTS=${REQUESTS:-20000}
+CONC=${CONC:-8}
+WINDOW=${WINDOW:-1000}
+MODE=${MODE:-epoll}
+
+if ! command -v curl > /dev/null; then
+    echo "ERROR: curl is needed for the report."
+    exit 1
+fi
+
+cd "$src" || exit 1
+if [[ ! -x ./serverbench ]]; then
+    echo "ERROR: ./serverbench is missing, run 'make'."
+    exit 1
+fi
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+mkdir -p hotset_files
+for ((i = 0; i < FILES; i++)); do
+    [[ -f hotset_files/$i ]] || head -c $SIZE < /dev/urandom > hotset_files/$i
+done
+
+# Zipf-like mix, split into one curl config per loop.
+awk -v n=$REQUESTS -v files=$FILES -v conc=$CONC -v port=$port -v dir="$tmp" 'BEGIN {
+    srand(1)
+    for (i = 0; i < n; i++) {
+        f = int(files ^ rand()) - 1
+        out = dir "/urls." (i % conc)
+        printf "url = \"http://127.0.0.1:%d/hotset_files/%d\"\noutput = /dev/null\n", port, f > out
+    }
+}'
+
+# Run the load; prints "<window> <p99_ms> <elapsed_ms>" per window.
+load() {
+    for ((j = 0; j < CONC; j++)); do
+	curl -s -K "$tmp/urls.$j" -w '%{time_total}\n' > "$tmp/times.$j" &
+    done
+    wait $(jobs -p | grep -v "^$pid$")
+    # Row r of every loop ran at about the same time; a loop's running sum
+    # is its elapsed time.
+    for ((j = 0; j < CONC; j++)); do
+	awk -v j=$j '{sum += $1; print NR, j, $1 * 1000, sum * 1000}' "$tmp/times.$j"
+    done | sort -n -k1,1 -k2,2 |
+	awk -v w=$WINDOW '{if ($4 > at) at = $4; print int(n / w), $3, at; n++}' |
+	sort -n -k1,1 -k2,2 |
+	awk '$1 != win {flush(); win = $1}
+	    {lat[++n] = $2; if ($3 > at) at = $3}
+	    function flush(  r) {
+		if (!n) return
+		r = int(n * 0.99)
+		if (r < 1) r = 1
+		printf "%d %.2f %.1f\n", win, lat[r], at
+		n = 0
+	    }
+	    END {flush()}'
+}
+
+start() {
+    if [[ -n $1 ]]; then export SERVER_HOT_SET=$1; else unset SERVER_HOT_SET; fi
+    ./serverbench 127.0.0.1:$port $MODE > /dev/null 2>> "$tmp/server.log" &
+    pid=$!
+    sleep 0.2
+}
+
+drop_page_cache() {
+    for ((i = 0; i < FILES; i++)); do
+	dd if=hotset_files/$i iflag=nocache count=0 status=none
+    done
+}
+
+start "$tmp/hot.set"
+load > /dev/null
+warm=$(load | awk '{print $2}' | sort -n | awk '{p[NR] = $1} END {print p[int((NR + 1) / 2)]}')
+kill -TERM $pid
+wait $pid
+
+printf "warm p99 %.2f ms, %d files, %d requests per run, windows of %d\n" \
+    "$warm" $FILES $REQUESTS $WINDOW | tee hotset_report.txt
+printf "%-8s %12s %10s %12s\n" "start" "first_p99" "window" "elapsed_ms" | tee -a hotset_report.txt
+for run in cold hot_set; do
+    drop_page_cache
+    if [[ $run == cold ]]; then start ""; else start "$tmp/hot.set"; fi
+    load | awk -v m=$run -v warm=$warm '
+	NR == 1 {first = $2}
+	!found && $2 <= warm * 1.25 {found = 1; win = $1; at = $3}
+	END {
+	    if (found) printf "%-8s %12.2f %10d %12.1f\n", m, first, win, at
+	    else printf "%-8s %12.2f %10s %12s\n", m, first, "never", "-"
+	}' | tee -a hotset_report.txt
+    kill -TERM $pid
+    wait $pid
+done
+grep "hot set" "$tmp/server.log"
@@ -0,0 +1,48 @@
+#!/bin/bash
+
+## PGO training workload, used by 'make pgo'. Starts the instrumented servers
+## found in directory $1, serves a mix of requests from them and shuts them
+## down with SIGTERM so the profile data gets written.
+
+dir=$(readlink -f "${1:-.}")
+src=$(dirname "$(readlink -f "$0")")
+portFORK=${portFORK:-18282}
+portTHREAD=${portTHREAD:-18283}
+REQUESTS=${REQUESTS:-5000}
+
+cd "$dir" || exit 1
+cp "$src/index.html" .
+head -c 10000 < /dev/urandom > big
+head -c 1000 < /dev/urandom > small
+
+## Send the training mix to port $1.
+train() {
+    local port=$1
+    if command -v ab > /dev/null; then
+	ab -q -n $REQUESTS -c 8 http://127.0.0.1:$port/big > /dev/null 2>&1
+	ab -q -n $REQUESTS -c 8 http://127.0.0.1:$port/small > /dev/null 2>&1
+	ab -q -n $((REQUESTS / 5)) -c 4 http://127.0.0.1:$port/ > /dev/null 2>&1
+    else
+	for ((i=0;i<REQUESTS/10;i++)); do
+	    curl -s http://127.0.0.1:$port/big http://127.0.0.1:$port/small http://127.0.0.1:$port/ > /dev/null
+	done
+    fi
+    ## Error paths: missing file, bad method, forbidden path.
+    for ((i=0;i<50;i++)); do
+	curl -s -o /dev/null http://127.0.0.1:$port/missing
+	curl -s -o /dev/null -X POST http://127.0.0.1:$port/big
+	curl -s -o /dev/null --path-as-is http://127.0.0.1:$port/../big
+    done
+}
+
+for server in "serverfork:$portFORK" "serverthread:$portTHREAD"; do
+    bin=${server%%:*}
+    port=${server##*:}
+    echo "Training $bin on port $port."
+    ./$bin 127.0.0.1:$port > /dev/null &
+    pid=$!
+    sleep 0.5
+    train $port
+    kill -TERM $pid
+    wait $pid
+done
@@ -0,0 +1,42 @@
+#ifndef PROBES_H
+#define PROBES_H
+
+/*
+ * USDT tracepoints on the request lifecycle, provider "webserver".
+ *
+ *   accept(fd)                        connection accepted
+ *   request_parsed(fd, path)          request line parsed and validated
+ *   file_opened(fd, path, size)       requested file opened
+ *   headers_sent(fd, status, size)    status line and headers written
+ *   body_done(fd, bytes)              response body written
+ *   close(fd, status)                 connection closed
+ *
+ * Each probe compiles to a single nop when nobody is attached. When
+ * <sys/sdt.h> (systemtap-sdt-dev) is missing, or NO_USDT is defined,
+ * they compile to nothing.
+ */
+
+#if defined(__has_include) && !defined(NO_USDT)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define HAVE_USDT 1
+#endif
+#endif
+
+#ifdef HAVE_USDT
+#define PROBE_ACCEPT(fd)                    DTRACE_PROBE1(webserver, accept, fd)
+#define PROBE_REQUEST_PARSED(fd, path)      DTRACE_PROBE2(webserver, request_parsed, fd, path)
+#define PROBE_FILE_OPENED(fd, path, size)   DTRACE_PROBE3(webserver, file_opened, fd, path, size)
+#define PROBE_HEADERS_SENT(fd, status, size) DTRACE_PROBE3(webserver, headers_sent, fd, status, size)
+#define PROBE_BODY_DONE(fd, bytes)          DTRACE_PROBE2(webserver, body_done, fd, bytes)
+#define PROBE_CLOSE(fd, status)             DTRACE_PROBE2(webserver, close, fd, status)
+#else
+#define PROBE_ACCEPT(fd)                    do {} while (0)
+#define PROBE_REQUEST_PARSED(fd, path)      do {} while (0)
+#define PROBE_FILE_OPENED(fd, path, size)   do {} while (0)
+#define PROBE_HEADERS_SENT(fd, status, size) do {} while (0)
+#define PROBE_BODY_DONE(fd, bytes)          do {} while (0)
+#define PROBE_CLOSE(fd, status)             do {} while (0)
+#endif
+
+#endif
@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <errno.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <cxxabi.h>
+#include <sys/time.h>
+
+#include "profiler.h"
+#include "server_core.h"
+
+// Frames of the signal handler and the kernel trampoline on top of each sample.
+#define PROFILER_SKIP_FRAMES 2
+
+struct profile_sample {
+    int depth;
+    void *pc[PROFILER_MAX_DEPTH];
+};
+
+static struct profile_sample *samples;
+static unsigned int next_sample;
+static unsigned int dropped_samples;
+static int handlers_running;        // SIGPROF handlers between entry and exit
+static int profile_count;
+
+static void sigprof_handler(int sig) {
+    (void)sig;
+    int saved_errno = errno;
+    // Counted in before reserving a slot, so stop_sampling() can wait for it.
+    __atomic_fetch_add(&handlers_running, 1, __ATOMIC_SEQ_CST);
+    unsigned int slot = __atomic_fetch_add(&next_sample, 1, __ATOMIC_SEQ_CST);
+    if (slot < PROFILER_MAX_SAMPLES) {
+        struct profile_sample *s = &samples[slot];
+        s->depth = backtrace(s->pc, PROFILER_MAX_DEPTH);
+    } else {
+        __atomic_fetch_add(&dropped_samples, 1, __ATOMIC_RELAXED);
+    }
+    __atomic_fetch_sub(&handlers_running, 1, __ATOMIC_RELEASE);
+    errno = saved_errno;
+}
+
+static int set_timer(int hz) {
+    struct itimerval it;
+    memset(&it, 0, sizeof(it));
+    if (hz > 0) {
+        it.it_interval.tv_usec = 1000000 / hz;
+        it.it_value = it.it_interval;
+    }
+    return setitimer(ITIMER_PROF, &it, NULL);
+}
+
+// Disarm the timer and return how many samples were taken. A SIGPROF
+// still pending gets no slot, and one that has a slot is waited for, so
+// the buffer is complete and no longer written once this returns.
+static unsigned int stop_sampling(void) {
+    set_timer(0);
+    unsigned int count = __atomic_exchange_n(&next_sample, PROFILER_MAX_SAMPLES, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&handlers_running, __ATOMIC_ACQUIRE)) usleep(1000);
+    return count < PROFILER_MAX_SAMPLES ? count : PROFILER_MAX_SAMPLES;
+}
+
+static int compare_samples(const void *a, const void *b) {
+    const struct profile_sample *x = (const struct profile_sample *)a;
+    const struct profile_sample *y = (const struct profile_sample *)b;
+    if (x->depth != y->depth) return x->depth - y->depth;
+    return memcmp(x->pc, y->pc, x->depth * sizeof(void *));
+}
+
+static void write_frame(FILE *out, void *pc) {
+    Dl_info info;
+    memset(&info, 0, sizeof(info));
+    // Return addresses point after the call; look up the call itself.
+    void *lookup = (char *)pc - 1;
+    int found = dladdr(lookup, &info) != 0;
+    if (found && info.dli_sname) {
+        int status = 0;
+        char *name = abi::__cxa_demangle(info.dli_sname, NULL, NULL, &status);
+        if (status == 0 && name) {
+            // Folded stacks use ';' and ' ' as separators, keep only the name.
+            char *paren = strchr(name, '(');
+            if (paren) *paren = '\0';
+            fputs(name, out);
+        } else {
+            fputs(info.dli_sname, out);
+        }
+        free(name);
+    } else if (found && info.dli_fname) {
+        const char *base = strrchr(info.dli_fname, '/');
+        fprintf(out, "[%s]", base ? base + 1 : info.dli_fname);
+    } else {
+        fprintf(out, "%p", pc);
+    }
+}
+
+static void write_profile(unsigned int n) {
+    char filename[64];
+    snprintf(filename, sizeof(filename), "profile.%d.%d.folded", (int)getpid(), profile_count++);
+    FILE *out = fopen(filename, "w");
+    if (!out) {
+        perror("profiler: fopen failed");
+        return;
+    }
+
+    qsort(samples, n, sizeof(samples[0]), compare_samples);
+
+    for (unsigned int i = 0; i < n;) {
+        unsigned int j = i + 1;
+        while (j < n && compare_samples(&samples[i], &samples[j]) == 0) j++;
+        // Root first, leaf last.
+        for (int f = samples[i].depth - 1; f >= PROFILER_SKIP_FRAMES; --f) {
+            write_frame(out, samples[i].pc[f]);
+            if (f > PROFILER_SKIP_FRAMES) fputc(';', out);
+        }
+        fprintf(out, " %u\n", j - i);
+        i = j;
+    }
+    fclose(out);
+    printf("Profiler: wrote %u samples (%u dropped) to %s\n", n, dropped_samples, filename);
+    fflush(stdout);
+}
+
+static void *profiler_thread(void *arg) {
+    sigset_t *set = (sigset_t *)arg;
+    int running = 0;
+    int sig;
+
+    // Started with every signal blocked: sigwait() still sees the toggle
+    // signal; everything else, including SIGPROF and SIGCHLD, goes to the
+    // serving threads.
+    while (sigwait(set, &sig) == 0) {
+        if (!running) {
+            memset(samples, 0, PROFILER_MAX_SAMPLES * sizeof(samples[0]));
+            __atomic_store_n(&next_sample, 0, __ATOMIC_RELAXED);
+            __atomic_store_n(&dropped_samples, 0, __ATOMIC_RELAXED);
+            if (set_timer(PROFILER_HZ) < 0) {
+                perror("profiler: setitimer failed");
+                continue;
+            }
+            running = 1;
+            printf("Profiler: sampling at %d Hz\n", PROFILER_HZ);
+            fflush(stdout);
+        } else {
+            running = 0;
+            write_profile(stop_sampling());
+        }
+    }
+    return NULL;
+}
+
+int profiler_init(void) {
+    static sigset_t toggle_set;
+
+    samples = (struct profile_sample *)calloc(PROFILER_MAX_SAMPLES, sizeof(samples[0]));
+    if (!samples) return -1;
+
+    // backtrace() loads libgcc on first use, which is not safe in a handler.
+    void *warmup[1];
+    backtrace(warmup, 1);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sigprof_handler;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGPROF, &sa, NULL) < 0) return -1;
+
+    sigemptyset(&toggle_set);
+    sigaddset(&toggle_set, PROFILER_TOGGLE_SIGNAL);
+    if (pthread_sigmask(SIG_BLOCK, &toggle_set, NULL) != 0) return -1;
+
+    return start_background_thread(profiler_thread, &toggle_set);
+}
@@ -0,0 +1,25 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+/*
+ * Signal-toggled sampling profiler.
+ *
+ * profiler_init() starts a small control thread that waits for SIGUSR2.
+ * The first SIGUSR2 arms ITIMER_PROF; every SIGPROF then records the stack
+ * of whichever thread was running into a preallocated lock-free buffer.
+ * The next SIGUSR2 disarms the timer and writes the samples as folded
+ * stacks (profile.<pid>.<n>.folded) for flamegraph.pl.
+ *
+ * Must be called from main() before any worker thread is created, since
+ * SIGUSR2 has to be blocked in every thread for sigwait() to see it.
+ * While the profiler is off no timer is armed and nothing runs.
+ */
+
+#define PROFILER_TOGGLE_SIGNAL SIGUSR2
+#define PROFILER_HZ 997
+#define PROFILER_MAX_SAMPLES 65536
+#define PROFILER_MAX_DEPTH 48
+
+int profiler_init(void);
+
+#endif
@@ -0,0 +1,219 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "response_headers.h"
+#include "header_builder.h"
+#include "etag.h"
+#include "server_core.h"
+
+struct header_template {
+    int lock;
+    char path[256];
+    off_t size;
+    time_t mtime_sec;
+    long mtime_nsec;
+    uint64_t tag;               // a combo's validator; 0 for files
+    int strong;                 // carries the content-hash ETag, not the weak one
+    size_t len;
+    size_t date_offset;
+    char header[HEADER_TEMPLATE_SIZE];
+};
+
+static char date_slots[2][HTTP_DATE_LEN + 1];
+static int date_current;
+static struct header_template header_cache[HEADER_CACHE_SLOTS];
+
+static const char day_names[] = "SunMonTueWedThuFriSat";
+static const char month_names[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+// IMF-fixdate, HTTP_DATE_LEN bytes plus a terminator.
+static void format_http_date(char *dst, time_t t) {
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    char *p = dst;
+    memcpy(p, day_names + tm.tm_wday * 3, 3);
+    memcpy(p + 3, ", ", 2);
+    memcpy(p + 5, digit_pairs + tm.tm_mday * 2, 2);
+    p[7] = ' ';
+    memcpy(p + 8, month_names + tm.tm_mon * 3, 3);
+    p[11] = ' ';
+    int year = tm.tm_year + 1900;
+    memcpy(p + 12, digit_pairs + (year / 100) * 2, 2);
+    memcpy(p + 14, digit_pairs + (year % 100) * 2, 2);
+    p[16] = ' ';
+    memcpy(p + 17, digit_pairs + tm.tm_hour * 2, 2);
+    p[19] = ':';
+    memcpy(p + 20, digit_pairs + tm.tm_min * 2, 2);
+    p[22] = ':';
+    memcpy(p + 23, digit_pairs + tm.tm_sec * 2, 2);
+    memcpy(p + 25, " GMT", 5);
+}
+
+// Format into the slot readers are not using, then publish it.
+void date_cache_update(time_t now) {
+    int next = !__atomic_load_n(&date_current, __ATOMIC_RELAXED);
+    format_http_date(date_slots[next], now);
+    __atomic_store_n(&date_current, next, __ATOMIC_RELEASE);
+}
+
+static void *date_timer(void *arg) {
+    (void)arg;
+    while (1) {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        date_cache_update(now.tv_sec);
+        // Wake just after the next second boundary.
+        struct timespec delay = { 0, 1000000000L - now.tv_nsec };
+        nanosleep(&delay, NULL);
+    }
+    return NULL;
+}
+
+void date_cache_start(void) {
+    date_cache_update(time(NULL));
+    // Every signal is left to the threads that wait for them (e.g. a signalfd).
+    start_background_thread(date_timer, NULL);
+}
+
+void date_cache_copy(char *dst) {
+    int current = __atomic_load_n(&date_current, __ATOMIC_ACQUIRE);
+    memcpy(dst, date_slots[current], HTTP_DATE_LEN);
+}
+
+static void slot_lock(struct header_template *t) {
+    while (__atomic_test_and_set(&t->lock, __ATOMIC_ACQUIRE)) {}
+}
+
+static void slot_unlock(struct header_template *t) {
+    __atomic_clear(&t->lock, __ATOMIC_RELEASE);
+}
+
+static unsigned int path_hash(const char *path) {
+    unsigned int h = 2166136261u;
+    for (; *path; ++path) h = (h ^ (unsigned char)*path) * 16777619u;
+    return h;
+}
+
+static int template_matches(const struct header_template *t, const char *path, const struct stat *st,
+                            uint64_t tag) {
+    return t->len > 0 && t->size == st->st_size && t->mtime_sec == st->st_mtim.tv_sec &&
+           t->mtime_nsec == st->st_mtim.tv_nsec && t->tag == tag && strcmp(t->path, path) == 0;
+}
+
+// Build the template for a file version; the Date field is patched per response.
+// strong_hash is the content hash when etag.h has it, else NULL for the weak
+// ETag. A combo passes its validator as tag, which is then the ETag value.
+static void build_template(struct header_template *t, const char *path, const struct stat *st,
+                           const char *mime_type, const uint64_t *strong_hash, uint64_t tag) {
+    char last_modified[HTTP_DATE_LEN + 1];
+    format_http_date(last_modified, st->st_mtime);
+
+    struct header_builder b;
+    hb_init(&b, t->header, sizeof(t->header));
+    hb_append_str(&b, "HTTP/1.1 200 OK\r\nDate: ");
+    t->date_offset = b.len;
+    hb_append(&b, last_modified, HTTP_DATE_LEN);   // placeholder, patched per response
+    hb_append_str(&b, "\r\nContent-Length: ");
+    hb_append_uint(&b, st->st_size);
+    hb_append_str(&b, "\r\n");
+    hb_append_header(&b, "Content-Type", mime_type);
+    hb_append_header(&b, "Last-Modified", last_modified);
+    if (strong_hash) {
+        hb_append_str(&b, "ETag: \"");
+        hb_append_hex(&b, *strong_hash, 16);
+    } else if (tag) {
+        hb_append_str(&b, "ETag: W/\"");
+        hb_append_hex(&b, tag, 16);
+    } else {
+        hb_append_str(&b, "ETag: W/\"");
+        hb_append_hex(&b, st->st_mtime, 1);
+        hb_append(&b, "-", 1);
+        hb_append_hex(&b, st->st_size, 1);
+    }
+    hb_append_str(&b, "\"\r\n");
+    hb_append_str(&b, "Connection: close\r\n\r\n");
+    t->len = hb_finish(&b);
+    size_t path_len = strlen(path);
+    if (path_len >= sizeof(t->path)) path_len = sizeof(t->path) - 1;
+    memcpy(t->path, path, path_len);
+    t->path[path_len] = '\0';
+    t->size = st->st_size;
+    t->mtime_sec = st->st_mtim.tv_sec;
+    t->mtime_nsec = st->st_mtim.tv_nsec;
+    t->tag = tag;
+    t->strong = strong_hash != NULL;
+}
+
+// Copy the template for path/st/tag into dst, building it when the slot has
+// another; returns its length, or 0 when it does not fit.
+static size_t copy_template(char *dst, size_t dst_size, const char *path, const struct stat *st,
+                            const char *mime_type, uint64_t tag, int strong_tag) {
+    struct header_template *slot = &header_cache[path_hash(path) % HEADER_CACHE_SLOTS];
+    size_t len = 0, date_offset = 0;
+
+    int strong = 0;
+    slot_lock(slot);
+    if (template_matches(slot, path, st, tag) && slot->len <= dst_size) {
+        len = slot->len;
+        date_offset = slot->date_offset;
+        strong = slot->strong;
+        memcpy(dst, slot->header, len);
+    }
+    slot_unlock(slot);
+
+    // A weak template is rebuilt once the content hash is ready.
+    uint64_t hash = tag;
+    int hashed = tag ? strong_tag : !strong && etag_enabled() && etag_lookup(path, st, &hash);
+    if (len == 0 || (hashed && !strong)) {
+        struct header_template fresh;
+        build_template(&fresh, path, st, mime_type, hashed ? &hash : NULL, tag);
+        if (fresh.len == 0 || fresh.len > dst_size) return 0;
+        slot_lock(slot);
+        memcpy(slot->header, fresh.header, fresh.len);
+        memcpy(slot->path, fresh.path, sizeof(slot->path));
+        slot->len = fresh.len;
+        slot->date_offset = fresh.date_offset;
+        slot->size = fresh.size;
+        slot->mtime_sec = fresh.mtime_sec;
+        slot->mtime_nsec = fresh.mtime_nsec;
+        slot->tag = fresh.tag;
+        slot->strong = fresh.strong;
+        slot_unlock(slot);
+
+        len = fresh.len;
+        date_offset = fresh.date_offset;
+        memcpy(dst, fresh.header, len);
+    }
+
+    if (date_offset + HTTP_DATE_LEN > len) return 0;
+    date_cache_copy(dst + date_offset);
+    return len;
+}
+
+size_t build_file_header(char *dst, size_t dst_size, const char *path, const struct stat *st,
+                         const char *mime_type) {
+    return copy_template(dst, dst_size, path, st, mime_type, 0, 0);
+}
+
+size_t build_combo_header(char *dst, size_t dst_size, const char *key, const struct stat *st,
+                          const char *mime_type, uint64_t validator, int strong) {
+    // 0 marks file templates.
+    return copy_template(dst, dst_size, key, st, mime_type, validator ? validator : 1, strong);
+}
+
+size_t build_error_response(char *dst, size_t dst_size, const char *response) {
+    const char *line_end = strstr(response, "\r\n");
+    size_t status_len = line_end ? (size_t)(line_end - response) + 2 : strlen(response);
+    char date[HTTP_DATE_LEN];
+    date_cache_copy(date);
+
+    struct header_builder b;
+    hb_init(&b, dst, dst_size);
+    hb_append(&b, response, status_len);
+    hb_append_str(&b, "Date: ");
+    hb_append(&b, date, HTTP_DATE_LEN);
+    hb_append_str(&b, "\r\n");
+    hb_append_str(&b, response + status_len);
+    return hb_finish(&b);
+}
@@ -0,0 +1,46 @@
+#ifndef RESPONSE_HEADERS_H
+#define RESPONSE_HEADERS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/stat.h>
+
+/*
+ * Cached pieces of response headers.
+ *
+ * The Date header value is formatted once per second by a timer thread
+ * into one of two slots and published by flipping an index, so readers
+ * only memcpy it. Every 200 response header is built once per file
+ * version (path, size, mtime) into a template; serving it again is a
+ * memcpy of the template plus patching the Date field in place.
+ */
+
+#define HTTP_DATE_LEN 29            // "Sun, 06 Nov 1994 08:49:37 GMT"
+#define HEADER_TEMPLATE_SIZE 512
+#define HEADER_CACHE_SLOTS 1024
+
+// Start the timer thread. Call again in forked children that outlive a second.
+void date_cache_start(void);
+// Set the Date value once, for a process that serves one connection and
+// needs no timer thread.
+void date_cache_update(time_t now);
+// Copy the current Date value (HTTP_DATE_LEN bytes, not terminated) to dst.
+void date_cache_copy(char *dst);
+
+// Write the 200 response header for path/st into dst; returns its length,
+// or 0 when it does not fit in dst_size bytes.
+size_t build_file_header(char *dst, size_t dst_size, const char *path, const struct stat *st,
+                         const char *mime_type);
+
+// The same for a combo response (key is its request path): st gives the
+// total length and newest part's mtime, validator the ETag, which is strong
+// when every part's is.
+size_t build_combo_header(char *dst, size_t dst_size, const char *key, const struct stat *st,
+                          const char *mime_type, uint64_t validator, int strong);
+
+// Write a canned error response into dst with a Date header inserted after
+// the status line; returns its length.
+size_t build_error_response(char *dst, size_t dst_size, const char *response);
+
+#endif
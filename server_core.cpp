@@ -0,0 +1,890 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/sendfile.h>
+#include <pthread.h>
+
+#include "server_core.h"
+#include "response_headers.h"
+#include "buffer_pool.h"
+#include "slow_writer.h"
+#include "file_cache.h"
+#include "hot_cache.h"
+#include "spill_cache.h"
+#include "hot_set.h"
+#include "handoff.h"
+#include "docroot_index.h"
+#include "etag.h"
+#include "content_hash.h"
+#include "early_hints.h"
+#include "docroot_switch.h"
+#include "ebr.h"
+#include "probes.h"
+
+volatile sig_atomic_t shutdown_requested = 0;
+static int listen_fd = -1;
+static pthread_t main_thread;
+static size_t max_header_size = DEFAULT_MAX_HEADER_SIZE;
+
+void log_error(const char *msg, int terminate) {
+    perror(msg);
+    if (terminate) exit(EXIT_FAILURE);
+}
+
+int start_background_thread(void *(*fn)(void *), void *arg) {
+    // The new thread inherits the mask, so no signal reaches it before fn runs.
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+    pthread_t tid;
+    int ret = pthread_create(&tid, NULL, fn, arg);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (ret != 0) return -1;
+    pthread_detach(tid);
+    return 0;
+}
+
+// ✅ MIME type detection function
+const char *get_mime_type(const char *filename) {
+    if (strstr(filename, ".html")) return "text/html";
+    if (strstr(filename, ".htm")) return "text/html";
+    if (strstr(filename, ".txt")) return "text/plain";
+    if (strstr(filename, ".jpg")) return "image/jpeg";
+    if (strstr(filename, ".jpeg")) return "image/jpeg";
+    if (strstr(filename, ".png")) return "image/png";
+    if (strstr(filename, ".css")) return "text/css";
+    if (strstr(filename, ".js")) return "application/javascript";
+    if (strstr(filename, ".json")) return "application/json";
+    if (strstr(filename, ".pdf")) return "application/pdf";
+    return "application/octet-stream";  // default
+}
+
+// Clamped to the largest buffer_pool class.
+void set_max_header_size(size_t size) {
+    size_t largest = buffer_class_size(BUFFER_CLASSES - 1);
+    max_header_size = size > largest ? largest : size;
+}
+
+void connection_init(struct connection *c, int fd) {
+    c->fd = fd;
+    c->state = CONN_READING;
+    c->status = 0;
+    c->recv_attempts = 0;
+    c->recv_class = 0;
+    c->recv_len = 0;
+    c->recv_buffer = buffer_get(c->recv_class);
+    c->recv_cap = c->recv_buffer ? buffer_class_size(c->recv_class) : 0;
+    if (c->recv_cap > max_header_size + 1) c->recv_cap = max_header_size + 1;
+    c->header_len = c->header_sent = 0;
+    c->response_content = NULL;
+    c->cached = NULL;
+    c->hot = NULL;
+    c->cache_held = 0;
+    c->interim_ok = 0;
+    c->combo = NULL;
+    c->content_len = c->content_sent = 0;
+    c->content_size = 0;
+    c->file_fd = -1;
+    c->file_offset = c->file_end = 0;
+    c->spill = NULL;
+    c->sendfile_ok = 1;
+    c->body_sendfile = 0;
+    c->bytes_out = 0;
+    c->progress_mark = 0;
+    c->check_at_ms = monotonic_ms() + RECV_TIMEOUT_MS;
+    c->rate_armed = 0;
+    c->prev = c->next = NULL;
+}
+
+static void release_recv_buffer(struct connection *c) {
+    buffer_put(c->recv_buffer, c->recv_class);
+    c->recv_buffer = NULL;
+    c->recv_cap = 0;
+}
+
+// Move the request into the next buffer class, up to max_header_size.
+static int grow_recv_buffer(struct connection *c) {
+    int cls = c->recv_class + 1;
+    if (cls >= BUFFER_CLASSES || buffer_class_size(c->recv_class) >= max_header_size) return -1;
+    char *bigger = buffer_get(cls);
+    if (!bigger) return -1;
+    memcpy(bigger, c->recv_buffer, c->recv_len + 1);
+    buffer_put(c->recv_buffer, c->recv_class);
+    c->recv_buffer = bigger;
+    c->recv_class = cls;
+    c->recv_cap = buffer_class_size(cls);
+    if (c->recv_cap > max_header_size + 1) c->recv_cap = max_header_size + 1;
+    return 0;
+}
+
+static void release_cached(struct connection *c) {
+    if (c->hot) hot_cache_return(c->hot);
+    else if (c->cache_held) file_cache_release(c->cached);
+    c->cached = NULL;
+    c->hot = NULL;
+    c->cache_held = 0;
+}
+
+struct combo_body {
+    int count;
+    struct cache_entry *parts[COMBO_MAX_PARTS];
+};
+
+static void release_combo(struct combo_body *combo) {
+    for (int i = 0; i < combo->count; ++i) file_cache_release(combo->parts[i]);
+    free(combo);
+}
+
+void connection_hold(struct connection *c) {
+    if (!c->cached || c->hot || c->cache_held) return;
+    file_cache_ref(c->cached);
+    c->cache_held = 1;
+}
+
+void connection_detach_thread(struct connection *c) {
+    if (c->hot) {
+        c->cached = hot_cache_detach(c->hot);
+        c->hot = NULL;
+        c->cache_held = 1;
+    }
+    connection_hold(c);
+}
+
+// Done with the body's file: close it, or let go of its spill segment.
+static void close_body_file(struct connection *c) {
+    if (c->spill) spill_segment_release(c->spill);
+    else close(c->file_fd);
+    c->spill = NULL;
+    c->file_fd = -1;
+}
+
+void connection_close(struct connection *c) {
+    release_recv_buffer(c);
+    if (c->status == 200) PROBE_BODY_DONE(c->fd, c->bytes_out - c->header_sent);
+    if (c->cached) release_cached(c);
+    else free(c->response_content);
+    c->response_content = NULL;
+    if (c->combo) release_combo(c->combo);
+    c->combo = NULL;
+    if (c->file_fd >= 0) close_body_file(c);
+    close(c->fd);
+    PROBE_CLOSE(c->fd, c->status);
+    c->state = CONN_DONE;
+}
+
+// Queue a canned error response; the connection closes once it is sent.
+static int set_error_response(struct connection *c, int status, const char *response) {
+    c->header_len = build_error_response(c->response_header, sizeof(c->response_header), response);
+    c->status = status;
+    return c->state = CONN_WRITING;
+}
+
+// Read the next window of the body from file_offset.
+static void fill_body_window(struct connection *c) {
+    size_t want = c->file_end - c->file_offset;
+    if (want > OUTPUT_QUEUE_LIMIT) want = OUTPUT_QUEUE_LIMIT;
+    size_t got = 0;
+    while (got < want) {
+        ssize_t n = pread(c->file_fd, c->response_content + got, want - got, c->file_offset + got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        got += n;
+    }
+    c->file_offset += got;
+    c->content_len = got;
+    c->content_sent = 0;
+}
+
+// The 200 header for file_path at st, after the page's early hints when
+// it is HTML and they are ready. 0 when it does not fit.
+static size_t build_response_header(struct connection *c, const struct stat *st) {
+    size_t hints = 0;
+    if (c->interim_ok && early_hints_enabled() && strcmp(c->mime_type, "text/html") == 0)
+        hints = early_hints_copy(c->file_path, st, c->response_header, sizeof(c->response_header) / 2);
+    size_t len = build_file_header(c->response_header + hints, sizeof(c->response_header) - hints, c->file_path, st,
+                                   c->mime_type);
+    return len ? hints + len : 0;
+}
+
+static int header_too_large(struct connection *c) {
+    return set_error_response(c, 500, "HTTP/1.1 500 Internal Server Error\r\n\r\nResponse header too large.\r\n");
+}
+
+// Serve the body from a file cache entry; a HEAD response lets go of it at once.
+static int serve_cached(struct connection *c, struct cache_entry *e, struct hot_slot *slot, int is_get) {
+    c->cached = e;
+    c->hot = slot;
+    PROBE_FILE_OPENED(c->fd, c->file_path, e->size);
+    c->header_len = build_response_header(c, &e->st);
+    if (!is_get || c->header_len == 0) release_cached(c);
+    if (c->header_len == 0) return header_too_large(c);
+    if (is_get) {
+        c->response_content = e->data;
+        c->content_len = c->content_size = e->size;
+    }
+    c->status = 200;
+    return c->state = CONN_WRITING;
+}
+
+// Send the body from file_fd, file_offset to file_end: by sendfile() when
+// asked and the backend can, otherwise through a window of at most
+// OUTPUT_QUEUE_LIMIT bytes, refilled as it drains.
+static int stream_body(struct connection *c, int use_sendfile) {
+    c->content_size = c->file_end - c->file_offset;
+    if (use_sendfile && c->sendfile_ok) {
+        c->body_sendfile = 1;
+        return 0;
+    }
+    size_t window = c->content_size < OUTPUT_QUEUE_LIMIT ? c->content_size : OUTPUT_QUEUE_LIMIT;
+    c->response_content = (char *)malloc(window);
+    if (!c->response_content && window > 0) {
+        close_body_file(c);
+        return -1;
+    }
+    fill_body_window(c);
+    if (c->file_offset >= c->file_end) close_body_file(c);
+    return 0;
+}
+
+// Spill tier hit: promote a small object back into memory, otherwise send
+// it from the spill segment.
+static int serve_spilled(struct connection *c, struct spill_entry *se, size_t path_len, unsigned int hash,
+                         long long now, int is_get) {
+    cache_tier_count(TIER_SPILL);
+    if (is_get && se->size <= FILE_CACHE_MAX_OBJECT) {
+        struct cache_entry *e = file_cache_insert(c->file_path, path_len, hash, se->segment->fd, se->offset,
+                                                  &se->st, now);
+        if (e) return serve_cached(c, e, NULL, is_get);
+    }
+    PROBE_FILE_OPENED(c->fd, c->file_path, se->size);
+    c->header_len = build_response_header(c, &se->st);
+    if (c->header_len == 0) return header_too_large(c);
+    if (is_get && se->size > 0) {
+        spill_segment_ref(se->segment);
+        c->spill = se->segment;
+        c->file_fd = se->segment->fd;
+        c->file_offset = se->offset;
+        c->file_end = se->offset + se->size;
+        if (stream_body(c, 1) < 0)
+            return set_error_response(c, 500, "HTTP/1.1 500 Internal Server Error\r\n\r\nMemory allocation failed.\r\n");
+    }
+    c->status = 200;
+    return c->state = CONN_WRITING;
+}
+
+// Cache miss: open the file and serve it from a new cache entry when it
+// fits, otherwise stream it through the output window.
+static int serve_file(struct connection *c, size_t path_len, unsigned int hash, long long now, int is_get,
+                      int use_cache) {
+    const char *file_path = c->file_path;
+    struct stat st;
+
+    int file_fd = open(file_path, O_RDONLY | O_CLOEXEC);
+    if (file_fd < 0)
+        return set_error_response(c, 404, "HTTP/1.1 404 Not Found\r\n\r\nThe requested file was not found.\r\n");
+
+    if (fstat(file_fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        close(file_fd);
+        return set_error_response(c, 404, "HTTP/1.1 404 Not Found\r\n\r\nThe requested file was not found.\r\n");
+    }
+    size_t content_size = st.st_size;
+    cache_tier_count(TIER_ORIGIN);
+    struct cache_entry *e = use_cache && is_get ? file_cache_insert(file_path, path_len, hash, file_fd, 0, &st, now)
+                                                : NULL;
+    if (e) {
+        close(file_fd);
+        return serve_cached(c, e, NULL, is_get);
+    }
+    PROBE_FILE_OPENED(c->fd, file_path, content_size);
+    if (use_cache && is_get && content_size > FILE_CACHE_MAX_OBJECT)
+        spill_cache_offer_file(file_path, path_len, hash, &st);
+
+    // ✅ Get MIME type from file extension
+    c->header_len = build_response_header(c, &st);
+    if (c->header_len == 0) {
+        close(file_fd);
+        return header_too_large(c);
+    }
+    if (is_get) {
+        c->file_fd = file_fd;
+        c->file_end = content_size;
+        if (stream_body(c, 0) < 0)
+            return set_error_response(c, 500, "HTTP/1.1 500 Internal Server Error\r\n\r\nMemory allocation failed.\r\n");
+    } else {
+        close(file_fd);
+    }
+    c->status = 200;
+    return c->state = CONN_WRITING;
+}
+
+// A combo part: its cache entry, read in on a miss. Inside an EBR section.
+// Returns 0, or the status to refuse the combo with: 404 when the part does
+// not exist, 413 when it is too big for the memory cache.
+static int combo_part(const char *path, size_t len, unsigned int hash, long long now, struct cache_entry **part) {
+    struct cache_entry *e = file_cache_lookup(path, len, hash, now);
+    if (e) {
+        cache_tier_count(TIER_MEMORY);
+        file_cache_count_hit(e);
+        *part = e;
+        return 0;
+    }
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return errno == ENOENT || errno == ENOTDIR ? 404 : errno == EACCES ? 403 : 500;
+    struct stat st;
+    int status = 0;
+    if (fstat(fd, &st) < 0) status = 500;
+    else if (!S_ISREG(st.st_mode)) status = 404;
+    else if (st.st_size > FILE_CACHE_MAX_OBJECT) status = 413;
+    if (status == 0) {
+        cache_tier_count(TIER_ORIGIN);
+        e = file_cache_insert(path, len, hash, fd, 0, &st, now);
+        if (!e) status = 500;
+    }
+    close(fd);
+    *part = e;
+    return status;
+}
+
+// The part's content hash when etag.h has it, else one of its version.
+static uint64_t part_validator(const struct cache_entry *e, int *strong) {
+    uint64_t hash;
+    if (etag_enabled() && etag_lookup(e->key.str, &e->st, &hash)) return hash;
+    *strong = 0;
+    uint64_t version[3] = { (uint64_t)e->st.st_size, (uint64_t)e->st.st_mtim.tv_sec * 1000000000ull +
+                            e->st.st_mtim.tv_nsec, (uint64_t)e->st.st_ino };
+    return content_hash(version, sizeof(version));
+}
+
+// "dir/??a.css,b.css" is dir/a.css followed by dir/b.css in one body, which
+// goes out by writev() straight from the parts' cache entries. Parts must
+// fit the memory cache and share the first one's MIME type. The length,
+// Last-Modified and ETag come from the parts' metadata, and the header is
+// kept as a template like a file's.
+static int serve_combo(struct connection *c, const char *marker, long long now, int is_get) {
+    const char *key = c->file_path;
+    size_t base_len = marker - key;
+    const char *list = marker + 2;
+    // A version suffix ("??a.css,b.css?v=2") is for caches, not a part.
+    size_t list_len = strcspn(list, "?");
+    struct combo_body *combo = (struct combo_body *)malloc(sizeof(*combo));
+    if (!combo)
+        return set_error_response(c, 500, "HTTP/1.1 500 Internal Server Error\r\n\r\nMemory allocation failed.\r\n");
+    combo->count = 0;
+
+    int own_section = !ebr_active();
+    if (own_section && ebr_enter() < 0) {
+        free(combo);
+        return set_error_response(c, 503, "HTTP/1.1 503 Service Unavailable\r\n\r\n");
+    }
+    char path[sizeof(c->file_path)];
+    memcpy(path, key, base_len);
+    const char *mime_type = NULL;
+    int status = list_len == 0 ? 400 : 0;
+    for (size_t at = 0; status == 0 && at < list_len;) {
+        size_t part_len = strcspn(list + at, ",?");
+        if (part_len == 0 || list[at] == '/' || combo->count == COMBO_MAX_PARTS) {
+            status = 400;
+            break;
+        }
+        size_t len = base_len + part_len;
+        memcpy(path + base_len, list + at, part_len);
+        path[len] = '\0';
+        at += part_len + 1;
+        int depth = 1;
+        for (size_t i = 0; i < len; ++i) depth += path[i] == '/';
+        if (depth > MAX_PATH_DEPTH) {
+            status = 403;
+            break;
+        }
+
+        unsigned int hash = file_cache_hash(path);
+        const char *type = docroot_mime_type(path, len, hash);
+        if (mime_type && strcmp(type, mime_type) != 0) {
+            status = 400;
+            break;
+        }
+        mime_type = type;
+        struct cache_entry *e;
+        if ((status = combo_part(path, len, hash, now, &e))) break;
+        file_cache_ref(e);
+        combo->parts[combo->count++] = e;
+    }
+    if (own_section) ebr_exit();
+    if (status) {
+        release_combo(combo);
+        if (status == 404)
+            return set_error_response(c, 404, "HTTP/1.1 404 Not Found\r\n\r\nThe requested file was not found.\r\n");
+        if (status == 403)
+            return set_error_response(c, 403, "HTTP/1.1 403 Forbidden\r\n\r\nInvalid path.\r\n");
+        if (status == 413)
+            return set_error_response(c, 413, "HTTP/1.1 413 Content Too Large\r\n\r\n"
+                                              "A combo part is too big to combine; request it on its own.\r\n");
+        if (status == 500)
+            return set_error_response(c, 500, "HTTP/1.1 500 Internal Server Error\r\n\r\nCould not read a combo part.\r\n");
+        return set_error_response(c, 400, "HTTP/1.1 400 Bad Request\r\n\r\nInvalid combo request.\r\n");
+    }
+
+    struct stat st;
+    memset(&st, 0, sizeof(st));
+    uint64_t validators[COMBO_MAX_PARTS];
+    int strong = 1;
+    for (int i = 0; i < combo->count; ++i) {
+        const struct cache_entry *e = combo->parts[i];
+        st.st_size += e->size;
+        if (e->st.st_mtim.tv_sec > st.st_mtim.tv_sec ||
+            (e->st.st_mtim.tv_sec == st.st_mtim.tv_sec && e->st.st_mtim.tv_nsec > st.st_mtim.tv_nsec))
+            st.st_mtim = e->st.st_mtim;
+        validators[i] = part_validator(e, &strong);
+    }
+    c->mime_type = mime_type;
+    PROBE_FILE_OPENED(c->fd, c->file_path, st.st_size);
+    c->header_len = build_combo_header(c->response_header, sizeof(c->response_header), c->file_path, &st, mime_type,
+                                       content_hash(validators, combo->count * sizeof(validators[0])), strong);
+    if (c->header_len == 0) {
+        release_combo(combo);
+        return header_too_large(c);
+    }
+    if (is_get) {
+        c->combo = combo;
+        c->content_len = c->content_size = st.st_size;
+    } else {
+        release_combo(combo);
+    }
+    c->status = 200;
+    return c->state = CONN_WRITING;
+}
+
+// The request headers are complete: validate them and build the response.
+static int handle_request(struct connection *c) {
+    char http_method[10], http_version[10];
+    char *file_path = c->file_path;
+
+    if (sscanf(c->recv_buffer, "%9s %255s %9s", http_method, file_path, http_version) != 3)
+        return set_error_response(c, 400, "HTTP/1.1 400 Bad Request\r\n\r\nMalformed request line.\r\n");
+
+    if (strcmp(http_method, "GET") != 0 && strcmp(http_method, "HEAD") != 0)
+        return set_error_response(c, 405, "HTTP/1.1 405 Method Not Allowed\r\n\r\nSupported methods: GET, HEAD.\r\n");
+
+    if (strcmp(http_version, "HTTP/1.1") != 0 && strcmp(http_version, "HTTP/1.0") != 0)
+        return set_error_response(c, 505, "HTTP/1.1 505 HTTP Version Not Supported\r\n\r\n");
+    c->interim_ok = http_version[7] == '1';
+
+    // One pass for the depth and, without the leading '/', the length and cache hash.
+    char *key = file_path[0] == '/' ? file_path + 1 : file_path;
+    int slash_count = key != file_path;
+    size_t path_len = 0;
+    unsigned int hash = FILE_CACHE_HASH_SEED;
+    for (; key[path_len]; ++path_len) {
+        if (key[path_len] == '/') slash_count++;
+        hash = file_cache_hash_step(hash, key[path_len]);
+    }
+    // A combo's parts are checked for depth one by one.
+    const char *combo = strstr(key, "??");
+    size_t combo_at = combo ? combo - key : 0;
+    if ((!combo && slash_count > MAX_PATH_DEPTH) || strstr(key, ".."))
+        return set_error_response(c, 403, "HTTP/1.1 403 Forbidden\r\n\r\nInvalid path.\r\n");
+
+    if (key != file_path) memmove(file_path, key, path_len + 1);
+    if (path_len == 0) {
+        strcpy(file_path, "index.html");
+        path_len = strlen(file_path);
+        hash = file_cache_hash(file_path);
+    }
+    PROBE_REQUEST_PARSED(c->fd, file_path);
+    int is_get = strcmp(http_method, "GET") == 0;
+    long long now = monotonic_ms();
+    if (combo) return serve_combo(c, file_path + combo_at, now, is_get);
+    c->mime_type = docroot_mime_type(file_path, path_len, hash);
+
+    struct hot_slot *slot = hot_cache_lookup(file_path, path_len, hash, now);
+    if (slot) {
+        cache_tier_count(TIER_MEMORY);
+        file_cache_count_hit(slot->entry);
+        return serve_cached(c, slot->entry, slot, is_get);
+    }
+    // Blocking workers are not in an EBR section (their reads may block for
+    // RECV_TIMEOUT_MS), so they open a short one around the lookup and the
+    // first write, and keep a reference only if that write would block.
+    int own_section = !ebr_active();
+    if (own_section && ebr_enter() < 0) return serve_file(c, path_len, hash, now, is_get, 0);
+    struct cache_entry *e = file_cache_lookup(file_path, path_len, hash, now);
+    struct spill_entry *se = e ? NULL : spill_cache_lookup(file_path, path_len, hash, now);
+    int state;
+    if (e) {
+        hot_cache_offer(e);
+        cache_tier_count(TIER_MEMORY);
+        file_cache_count_hit(e);
+        state = serve_cached(c, e, NULL, is_get);
+    } else if (se) {
+        state = serve_spilled(c, se, path_len, hash, now, is_get);
+    } else {
+        state = serve_file(c, path_len, hash, now, is_get, 1);
+    }
+    if (own_section) {
+        if (state == CONN_WRITING && set_nonblocking(c->fd) == 0) state = connection_on_writable(c);
+        else connection_hold(c);
+        ebr_exit();
+    }
+    return state;
+}
+
+char *connection_recv_space(struct connection *c, size_t *len) {
+    *len = c->recv_cap ? c->recv_cap - 1 - c->recv_len : 0;
+    return c->recv_buffer + c->recv_len;
+}
+
+int connection_received(struct connection *c, size_t n) {
+    if (c->state != CONN_READING) return c->state;
+    if (!c->recv_buffer)
+        return set_error_response(c, 500, "HTTP/1.1 500 Internal Server Error\r\n\r\nMemory allocation failed.\r\n");
+
+    // Only the new bytes (and 3 before them) can complete the terminator.
+    size_t scan_from = c->recv_len > 3 ? c->recv_len - 3 : 0;
+    c->recv_len += n;
+    c->recv_buffer[c->recv_len] = '\0';
+    if (strstr(c->recv_buffer + scan_from, "\r\n\r\n")) {
+        int state = handle_request(c);
+        release_recv_buffer(c);
+        return state;
+    }
+    if (c->recv_len >= c->recv_cap - 1 && grow_recv_buffer(c) < 0)
+        return set_error_response(c, 431, "HTTP/1.1 431 Request Header Fields Too Large\r\n\r\nRequest headers too large.\r\n");
+    return CONN_READING;
+}
+
+int connection_output(struct connection *c, struct iovec *iov, int max_iov) {
+    int n = 0;
+    if (c->header_sent < c->header_len && n < max_iov) {
+        iov[n].iov_base = c->response_header + c->header_sent;
+        iov[n].iov_len = c->header_len - c->header_sent;
+        n++;
+    }
+    if (c->combo) {
+        // Skip the parts already sent, then point at the rest in place.
+        size_t skip = c->content_sent;
+        for (int i = 0; i < c->combo->count && n < max_iov; ++i) {
+            struct cache_entry *e = c->combo->parts[i];
+            if (skip >= e->size) {
+                skip -= e->size;
+                continue;
+            }
+            iov[n].iov_base = e->data + skip;
+            iov[n].iov_len = e->size - skip;
+            n++;
+            skip = 0;
+        }
+        return n;
+    }
+    if (c->content_sent < c->content_len && n < max_iov) {
+        iov[n].iov_base = c->response_content + c->content_sent;
+        iov[n].iov_len = c->content_len - c->content_sent;
+        n++;
+    }
+    return n;
+}
+
+int connection_sent(struct connection *c, size_t n) {
+    c->bytes_out += n;
+    size_t header_left = c->header_len - c->header_sent;
+    if (header_left > 0) {
+        size_t step = n < header_left ? n : header_left;
+        c->header_sent += step;
+        n -= step;
+        if (c->header_sent == c->header_len) PROBE_HEADERS_SENT(c->fd, c->status, c->content_size);
+    }
+    if (c->body_sendfile) {
+        // sendfile() has moved file_offset already.
+        if (c->file_fd >= 0 && c->file_offset >= c->file_end) close_body_file(c);
+    } else {
+        c->content_sent += n;
+        if (c->content_sent == c->content_len && c->file_fd >= 0) {
+            fill_body_window(c);
+            // A file that shrank under us ends the response early.
+            if (c->content_len == 0) return c->state = CONN_DONE;
+            if (c->file_offset >= c->file_end) close_body_file(c);
+        }
+    }
+    if (c->header_sent == c->header_len && c->content_sent == c->content_len && c->file_fd < 0)
+        return c->state = CONN_DONE;
+    return CONN_WRITING;
+}
+
+// Read until the headers are complete, the peer stops sending or (on a
+// non-blocking socket) there is nothing more to read for now.
+int connection_on_readable(struct connection *c) {
+    while (c->state == CONN_READING) {
+        if (c->recv_attempts++ >= MAX_RECV_ATTEMPTS) return c->state = CONN_DONE;
+        size_t space;
+        char *buf = connection_recv_space(c, &space);
+        if (space == 0) return connection_received(c, 0);
+        ssize_t n = recv(c->fd, buf, space, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return CONN_READING;
+        if (n <= 0) return c->state = CONN_DONE;
+        connection_received(c, n);
+    }
+    return c->state;
+}
+
+int connection_on_writable(struct connection *c) {
+    struct iovec iov[MAX_OUTPUT_IOV];
+    while (c->state == CONN_WRITING) {
+        ssize_t sent;
+        if (c->body_sendfile && c->header_sent == c->header_len) {
+            sent = sendfile(c->fd, c->file_fd, &c->file_offset, c->file_end - c->file_offset);
+        } else if (c->body_sendfile) {
+            // The header goes out with the start of the body.
+            sent = send(c->fd, c->response_header + c->header_sent, c->header_len - c->header_sent, MSG_MORE);
+        } else {
+            int iovcnt = connection_output(c, iov, MAX_OUTPUT_IOV);
+            sent = writev(c->fd, iov, iovcnt);
+        }
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            connection_hold(c);
+            return CONN_WRITING;
+        }
+        if (sent <= 0) return c->state = CONN_DONE;
+        connection_sent(c, sent);
+    }
+    return c->state;
+}
+
+long long monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+long long monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int connection_too_slow(struct connection *c, long long now_ms) {
+    if (now_ms < c->check_at_ms) return 0;
+    if (c->state == CONN_READING) return 1;
+    if (c->rate_armed && c->bytes_out - c->progress_mark < (size_t)MIN_TRANSFER_RATE * RATE_CHECK_INTERVAL_MS / 1000)
+        return 1;
+    c->rate_armed = 1;
+    c->progress_mark = c->bytes_out;
+    c->check_at_ms = now_ms + RATE_CHECK_INTERVAL_MS;
+    return 0;
+}
+
+void set_abortive_close(int fd) {
+    struct linger lg = { 1, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+}
+
+// Wait out a response on a socket that is already non-blocking.
+static void drain_blocking(struct connection *c) {
+    while (c->state == CONN_WRITING) {
+        long long now = monotonic_ms();
+        if (connection_too_slow(c, now)) {
+            set_abortive_close(c->fd);
+            return;
+        }
+        struct pollfd pfd = { c->fd, POLLOUT, 0 };
+        int ready = poll(&pfd, 1, (int)(c->check_at_ms - now));
+        if (ready < 0 && errno != EINTR) return;
+        if (ready > 0) connection_on_writable(c);
+    }
+}
+
+int process_client_request(int client_fd) {
+    struct connection conn;
+    connection_init(&conn, client_fd);
+
+    struct timeval timeout;
+    timeout.tv_sec = RECV_TIMEOUT_MS / 1000;
+    timeout.tv_usec = (RECV_TIMEOUT_MS % 1000) * 1000;
+    setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    // On a blocking socket, still READING here means the receive timed out.
+    if (connection_on_readable(&conn) == CONN_WRITING) {
+        set_nonblocking(client_fd);
+        if (connection_on_writable(&conn) == CONN_WRITING) {
+            connection_detach_thread(&conn);
+            if (slow_writer_adopt(&conn) == 0) return 1;
+            drain_blocking(&conn);
+        }
+    }
+    connection_close(&conn);
+    return 0;
+}
+
+int initialize_server_socket(const char *address, const char *port) {
+    struct addrinfo hints, *server_info;
+    int server_fd;
+    int opt = 1;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+
+    if (getaddrinfo(address, port, &hints, &server_info) != 0)
+        log_error("getaddrinfo failed", 1);
+
+    server_fd = socket(server_info->ai_family, server_info->ai_socktype, server_info->ai_protocol);
+    if (server_fd < 0)
+        log_error("socket creation failed", 1);
+
+    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0)
+        log_error("setsockopt failed", 1);
+
+    if (bind(server_fd, server_info->ai_addr, server_info->ai_addrlen) < 0)
+        log_error("bind failed", 1);
+
+    if (listen(server_fd, 100) < 0)
+        log_error("listen failed", 1);
+
+    freeaddrinfo(server_info);
+    return server_fd;
+}
+
+// SIGTERM/SIGINT: stop accepting and return from main, so that exit handlers
+// (e.g. PGO profile dumps) run. shutdown() wakes a blocked accept() even when
+// the signal lands on another thread.
+static void handle_shutdown(int sig) {
+    (void)sig;
+    shutdown_requested = 1;
+    if (listen_fd >= 0) shutdown(listen_fd, SHUT_RDWR);
+}
+
+void server_handoff_shutdown(void) {
+    listen_fd = -1;
+    pthread_kill(main_thread, SIGTERM);
+}
+
+// Pass -1 in processes that closed their copy of the listening socket.
+void install_shutdown_handler(int server_fd) {
+    listen_fd = server_fd;
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_shutdown;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+}
+
+int accept_client(int server_fd, struct sockaddr *addr, socklen_t *addr_len) {
+    while (1) {
+        int client_fd = accept(server_fd, addr, addr_len);
+        if (client_fd >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) return client_fd;
+        struct pollfd pfd = { server_fd, POLLIN, 0 };
+        if (poll(&pfd, 1, -1) < 0) return -1;
+    }
+}
+
+void log_accept(const struct server_config *config, int client_fd) {
+    PROBE_ACCEPT(client_fd);
+    if (config->log_accepts) {
+        printf("Accepted connection\n");
+        fflush(stdout);
+    }
+}
+
+int worker_count(const struct server_config *config) {
+    if (config->workers > 0) return config->workers;
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+int set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0) return -1;
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+void parse_address_port(const char *arg, struct server_config *config) {
+    char *input = strdup(arg);
+    config->address = strtok(input, ":");
+    config->port = strtok(NULL, ":");
+
+    if (!config->address || !config->port) {
+        fprintf(stderr, "Invalid address:port format\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void caches_start(int server_fd) {
+    if (spill_cache_start() < 0) log_error("spill cache start failed", 0);
+    if (hot_set_start() < 0) log_error("hot set start failed", 0);
+    if (etag_start() < 0) log_error("etag start failed", 0);
+    if (docroot_switch_start() < 0) log_error("docroot switch start failed", 0);
+    if (early_hints_start() < 0) log_error("early hints start failed", 0);
+    if (server_fd >= 0 && handoff_start(server_fd) < 0) log_error("handoff start failed", 0);
+}
+
+void caches_stop(void) {
+    spill_cache_report(stderr);
+    if (hot_set_save() < 0) log_error("hot set save failed", 0);
+}
+
+// A relative path from the configuration, made absolute so that it names
+// the same file after the document root chdir().
+static const char *before_chdir(const char *path) {
+    char cwd[PATH_MAX];
+    if (!path || path[0] == '/' || !getcwd(cwd, sizeof(cwd))) return path;
+    size_t len = strlen(cwd) + strlen(path) + 2;
+    char *absolute = (char *)malloc(len);
+    if (!absolute) return path;
+    snprintf(absolute, len, "%s/%s", cwd, path);
+    return absolute;
+}
+
+int server_run(const char *backend_name, const struct server_config *config) {
+    const struct server_backend *backend = find_backend(backend_name);
+    if (!backend) {
+        fprintf(stderr, "Unknown backend '%s'. Available backends:\n", backend_name);
+        list_backends(stderr);
+        return EXIT_FAILURE;
+    }
+
+    if (config->max_header_size) set_max_header_size(config->max_header_size);
+    int rebase = config->docroot_link != NULL;
+    spill_cache_configure(rebase ? before_chdir(config->spill_dir) : config->spill_dir, config->spill_bytes);
+    hot_set_configure(rebase ? before_chdir(config->hot_set_path) : config->hot_set_path);
+    handoff_configure(rebase ? before_chdir(config->handoff_path) : config->handoff_path);
+    etag_configure(config->strong_etags);
+    early_hints_configure(config->early_hints);
+    main_thread = pthread_self();
+    if (docroot_switch_configure(config->docroot_link, config->scan_threads) < 0)
+        log_error("document root link unusable", 1);
+    // Before taking over or binding, so a predecessor serves meanwhile.
+    if (config->scan_threads > 0 && docroot_scan(config->scan_threads) < 0) log_error("docroot scan failed", 0);
+
+    // Clients that disconnect mid-response must not kill the server.
+    signal(SIGPIPE, SIG_IGN);
+
+    int server_fd = handoff_receive();
+    if (server_fd < 0) server_fd = initialize_server_socket(config->address, config->port);
+    install_shutdown_handler(server_fd);
+    date_cache_start();
+    // Processes without a cache (fork, spawn, the prefork parents) still
+    // follow the root for the children they start.
+    if (docroot_switch_start() < 0) log_error("docroot switch start failed", 0);
+    printf("Server is listening on %s:%s\n", config->address, config->port);
+    fflush(stdout);
+
+    int ret = backend->run(server_fd, config);
+    caches_stop();
+
+    close(server_fd);
+    return ret;
+}
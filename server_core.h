@@ -0,0 +1,174 @@
+#ifndef SERVER_CORE_H
+#define SERVER_CORE_H
+
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+/*
+ * Request handling shared by every concurrency backend.
+ *
+ * A connection is a small state machine that does no I/O of its own:
+ * the caller reads into connection_recv_space() and reports the byte
+ * count with connection_received(), then writes what connection_output()
+ * returns and reports progress with connection_sent(). Each call returns
+ * the next state, so the same code drives blocking sockets, epoll and
+ * io_uring alike. connection_on_readable()/connection_on_writable() are
+ * the plain recv/writev drivers used by the blocking and epoll backends.
+ *
+ * Event loops run each batch of events inside an EBR section (ebr.h), so
+ * a response served from the file cache and finished within the batch
+ * never touches a shared counter.
+ */
+
+#define RESPONSE_HEADER_SIZE 1024
+#define DEFAULT_MAX_HEADER_SIZE 32768   // larger request headers get a 431
+#define MAX_PATH_DEPTH 2
+#define RECV_TIMEOUT_MS 5000
+#define MAX_RECV_ATTEMPTS 100
+#define COMBO_MAX_PARTS 16         // each at most FILE_CACHE_MAX_OBJECT bytes, or the combo gets a 413
+#define MAX_OUTPUT_IOV (1 + COMBO_MAX_PARTS)    // header and body parts
+#define OUTPUT_QUEUE_LIMIT (256 * 1024)     // body bytes buffered per connection
+#define MIN_TRANSFER_RATE 1024              // bytes/s, checked every RATE_CHECK_INTERVAL_MS
+#define RATE_CHECK_INTERVAL_MS 10000
+
+enum conn_state {
+    CONN_READING,
+    CONN_WRITING,
+    CONN_DONE
+};
+
+struct cache_entry;
+struct combo_body;
+struct hot_slot;
+struct spill_segment;
+
+struct connection {
+    int fd;
+    int state;
+    int status;
+    int recv_attempts;
+    int recv_class;             // buffer_pool class of recv_buffer
+    size_t recv_len, recv_cap;
+    char *recv_buffer;          // pooled; starts at 1 KiB, released once parsed
+    char file_path[256];
+    const char *mime_type;      // of file_path, from the docroot index when it has it
+    int interim_ok;             // an HTTP/1.1 request, which may get a 103 first
+    char response_header[RESPONSE_HEADER_SIZE];
+    size_t header_len, header_sent;
+    char *response_content;     // window of at most OUTPUT_QUEUE_LIMIT body bytes, or cached->data
+    struct cache_entry *cached; // file cache entry serving the body
+    struct hot_slot *hot;       // set when cached is borrowed from this thread's hot cache
+    int cache_held;             // holds a reference to cached; otherwise EBR protects it
+    struct combo_body *combo;   // a combo response's parts, held, instead of response_content
+    size_t content_len, content_sent;
+    size_t content_size;        // whole body
+    int file_fd;                // open while the body is streamed from a file
+    off_t file_offset, file_end;
+    struct spill_segment *spill;    // file_fd belongs to this spill segment, held
+    int sendfile_ok;            // the backend sends with connection_on_writable()
+    int body_sendfile;          // body goes out by sendfile() from file_fd, not the window
+    size_t bytes_out;           // header + body bytes written so far
+    size_t progress_mark;       // bytes_out at the last rate check
+    long long check_at_ms;      // next timeout/rate check, see connection_too_slow()
+    int rate_armed;
+    struct connection *prev, *next;     // for the owner's list of live connections
+};
+
+struct server_config {
+    const char *address;
+    const char *port;
+    int workers;        // prefork/pool/epoll/io_uring; 0 = one per CPU
+    int log_accepts;    // print "Accepted connection" per accept
+    size_t max_header_size;     // 0 = DEFAULT_MAX_HEADER_SIZE
+    const char *spill_dir;      // NULL = no spill cache tier
+    unsigned long long spill_bytes;     // 0 = SPILL_DEFAULT_BYTES
+    const char *hot_set_path;   // NULL = no hot-set snapshot (hot_set.h)
+    const char *handoff_path;   // NULL = no cache handoff on upgrade (handoff.h)
+    int scan_threads;           // docroot scan at startup (docroot_index.h); 0 = none
+    const char *docroot_link;   // NULL = serve the working directory (docroot_switch.h)
+    int strong_etags;           // content-hash ETags (etag.h); 0 = weak mtime-size ones
+    int early_hints;            // 103 Early Hints for HTML pages (early_hints.h)
+};
+
+struct server_backend {
+    const char *name;
+    const char *description;
+    int (*run)(int server_fd, const struct server_config *config);
+};
+
+extern volatile sig_atomic_t shutdown_requested;
+
+void log_error(const char *msg, int terminate);
+// Run fn(arg) on a detached thread that has every signal blocked from its
+// start, leaving them to the serving threads. -1 when it cannot be created.
+int start_background_thread(void *(*fn)(void *), void *arg);
+const char *get_mime_type(const char *filename);
+
+void set_max_header_size(size_t size);
+void connection_init(struct connection *c, int fd);
+void connection_close(struct connection *c);
+// Take a reference to a cached body that is only EBR-protected, so the
+// connection can outlive the current section (see file_cache.h).
+// connection_on_writable() does this itself before returning CONN_WRITING.
+void connection_hold(struct connection *c);
+// Make the connection safe to finish on another thread (see hot_cache.h).
+void connection_detach_thread(struct connection *c);
+char *connection_recv_space(struct connection *c, size_t *len);
+int connection_received(struct connection *c, size_t n);
+int connection_output(struct connection *c, struct iovec *iov, int max_iov);
+int connection_sent(struct connection *c, size_t n);
+int connection_on_readable(struct connection *c);
+int connection_on_writable(struct connection *c);
+
+// Per serving process, after any fork: the spill tier's writer, the
+// hot-set prefetch and saves, the ETag hashing and early hints threads,
+// and the handoff of server_fd with the cache
+// to a successor (-1 in worker processes, whose caches are their own).
+// caches_stop() reports and saves on the way out.
+void caches_start(int server_fd);
+void caches_stop(void);
+
+long long monotonic_ms(void);
+long long monotonic_us(void);
+// True once a request took longer than RECV_TIMEOUT_MS to arrive, or a
+// response drains slower than MIN_TRANSFER_RATE. Event loops call this for
+// every live connection about once a second.
+int connection_too_slow(struct connection *c, long long now_ms);
+// Make the next close() send a RST and drop unsent data, so a connection
+// cut for being too slow frees its socket buffer at once.
+void set_abortive_close(int fd);
+
+// Serve one request on a blocking socket. Cache lookups and the first
+// non-blocking write take only short EBR sections; the connection holds or
+// detaches its entry before any wait, so no blocking write runs inside one. If the response does not
+// fit in the socket buffer it is handed to the slow writer when one runs
+// in this process (see slow_writer.h); otherwise the caller waits for it,
+// within the MIN_TRANSFER_RATE limit. Returns 1 when the slow writer took
+// the connection, 0 when it is closed.
+int process_client_request(int client_fd);
+
+int initialize_server_socket(const char *address, const char *port);
+void install_shutdown_handler(int server_fd);
+// A successor has the listening socket (handoff.h): stop as on SIGTERM,
+// without shutting the socket down.
+void server_handoff_shutdown(void);
+// accept() for loops that block in it. A listening socket taken over in a
+// handoff may have been made non-blocking by its previous owner, so this
+// waits in poll() instead of returning EAGAIN.
+int accept_client(int server_fd, struct sockaddr *addr, socklen_t *addr_len);
+void log_accept(const struct server_config *config, int client_fd);
+int worker_count(const struct server_config *config);
+int set_nonblocking(int fd);
+
+const struct server_backend *find_backend(const char *name);
+void list_backends(FILE *out);
+
+// Split "address:port" from argv; exits on malformed input.
+void parse_address_port(const char *arg, struct server_config *config);
+// Bind, install the shutdown handler and run the named backend until shutdown.
+int server_run(const char *backend_name, const struct server_config *config);
+
+#endif
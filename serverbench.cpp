@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "server_core.h"
+#include "profiler.h"
+
+// SERVER_BALLAST_MB=<n> makes the server touch n MiB before it starts, to
+// stand in for in-process caches when comparing fork and spawn costs
+// (see spawn_report.sh).
+static void add_ballast(void) {
+    const char *mb = getenv("SERVER_BALLAST_MB");
+    if (!mb) return;
+    size_t size = strtoul(mb, NULL, 10) << 20;
+    if (size == 0) return;
+    char *ballast = (char *)malloc(size);
+    if (!ballast) log_error("ballast malloc failed", 1);
+    memset(ballast, 1, size);
+}
+
+// SERVER_SPILL_DIR=<dir> adds the spill cache tier there, with
+// SERVER_SPILL_MB=<n> MiB of log (default 4096). SERVER_HOT_SET=<file>
+// saves the hot set there and prefetches it on the next start.
+// SERVER_HANDOFF=<socket> takes over the listening socket and the cache
+// from a server started with the same path, then waits there for the next.
+// SERVER_SCAN_THREADS=<n> indexes the document root at startup on n
+// threads (0 = one per CPU). SERVER_STRONG_ETAGS=1 sends content-hash
+// ETags once they are computed. SERVER_EARLY_HINTS=1 sends 103 Early Hints
+// for HTML pages. SERVER_DOCROOT=<link> serves the directory
+// the link points to and follows it to new releases.
+static void configure_caches(struct server_config *config) {
+    config->spill_dir = getenv("SERVER_SPILL_DIR");
+    const char *mb = getenv("SERVER_SPILL_MB");
+    if (mb) config->spill_bytes = strtoull(mb, NULL, 10) << 20;
+    config->hot_set_path = getenv("SERVER_HOT_SET");
+    config->handoff_path = getenv("SERVER_HANDOFF");
+    config->docroot_link = getenv("SERVER_DOCROOT");
+    const char *strong = getenv("SERVER_STRONG_ETAGS");
+    config->strong_etags = strong && atoi(strong) > 0;
+    const char *hints = getenv("SERVER_EARLY_HINTS");
+    config->early_hints = hints && atoi(hints) > 0;
+    const char *scan = getenv("SERVER_SCAN_THREADS");
+    if (scan) {
+        config->scan_threads = atoi(scan);
+        if (config->scan_threads <= 0) config->scan_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+}
+
+// One binary for every concurrency backend, for side-by-side benchmarks
+// (see backend_report.sh). Unlike serverfork/serverthread it does not log
+// each accepted connection.
+int main(int argc, char *argv[]) {
+    if (argc < 3 || argc > 4) {
+        fprintf(stderr, "Usage: %s <address:port> <backend> [workers]\nBackends:\n", argv[0]);
+        list_backends(stderr);
+        exit(EXIT_FAILURE);
+    }
+
+    struct server_config config = { NULL, NULL, 0, 0 };
+    parse_address_port(argv[1], &config);
+    if (argc == 4) config.workers = atoi(argv[3]);
+
+    if (profiler_init() < 0)
+        log_error("profiler init failed", 0);
+    add_ballast();
+    configure_caches(&config);
+
+    return server_run(argv[2], &config);
+}
@@ -0,0 +1,26 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "server_core.h"
+#include "response_headers.h"
+
+// Serves the one connection on stdin and exits. Started by the 'spawn'
+// backend instead of forking the server; argv[1] is the request header
+// limit (0 = default).
+int main(int argc, char *argv[]) {
+    if (argc > 2) {
+        fprintf(stderr, "Usage: %s [max_header_size] < connection\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    size_t max_header = argc == 2 ? strtoul(argv[1], NULL, 10) : 0;
+    if (max_header) set_max_header_size(max_header);
+    signal(SIGPIPE, SIG_IGN);
+    install_shutdown_handler(-1);
+    date_cache_update(time(NULL));
+
+    process_client_request(STDIN_FILENO);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <pthread.h>
+
+#include "slow_writer.h"
+
+#define SLOW_WRITER_MAX_EVENTS 64
+#define SLOW_WRITER_TICK_MS 1000
+
+static int writer_epfd = -1;
+static pid_t writer_pid;
+static pthread_mutex_t writer_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct connection *writer_conns;     // adopted connections, for rate checks
+static void (*done_hook)(void);
+
+// Caller holds writer_lock.
+static void list_remove(struct connection *c) {
+    if (c->prev) c->prev->next = c->next;
+    else writer_conns = c->next;
+    if (c->next) c->next->prev = c->prev;
+}
+
+static void unlink_conn(struct connection *c) {
+    pthread_mutex_lock(&writer_lock);
+    list_remove(c);
+    pthread_mutex_unlock(&writer_lock);
+}
+
+static void finish(struct connection *c) {
+    unlink_conn(c);
+    connection_close(c);
+    free(c);
+    if (done_hook) done_hook();
+}
+
+static void close_slow_connections(void) {
+    long long now = monotonic_ms();
+    struct connection *slow = NULL;
+
+    pthread_mutex_lock(&writer_lock);
+    for (struct connection *c = writer_conns; c;) {
+        struct connection *next = c->next;
+        if (connection_too_slow(c, now)) {
+            list_remove(c);
+            c->next = slow;
+            slow = c;
+        }
+        c = next;
+    }
+    pthread_mutex_unlock(&writer_lock);
+
+    while (slow) {
+        struct connection *next = slow->next;
+        set_abortive_close(slow->fd);
+        connection_close(slow);
+        free(slow);
+        if (done_hook) done_hook();
+        slow = next;
+    }
+}
+
+static void *slow_writer_loop(void *arg) {
+    (void)arg;
+    struct epoll_event events[SLOW_WRITER_MAX_EVENTS];
+    long long next_tick = monotonic_ms() + SLOW_WRITER_TICK_MS;
+
+    while (!shutdown_requested) {
+        int n = epoll_wait(writer_epfd, events, SLOW_WRITER_MAX_EVENTS, SLOW_WRITER_TICK_MS);
+        for (int i = 0; i < n; ++i) {
+            struct connection *c = (struct connection *)events[i].data.ptr;
+            if (connection_on_writable(c) != CONN_WRITING) finish(c);
+        }
+        if (monotonic_ms() >= next_tick) {
+            close_slow_connections();
+            next_tick = monotonic_ms() + SLOW_WRITER_TICK_MS;
+        }
+    }
+    return NULL;
+}
+
+int slow_writer_start(void) {
+    writer_epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (writer_epfd < 0) return -1;
+    writer_pid = getpid();
+
+    if (start_background_thread(slow_writer_loop, NULL) < 0) {
+        close(writer_epfd);
+        writer_epfd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+void slow_writer_set_done_hook(void (*hook)(void)) {
+    done_hook = hook;
+}
+
+int slow_writer_adopt(const struct connection *c) {
+    // A forked child inherits writer_epfd but not the thread serving it.
+    if (writer_epfd < 0 || writer_pid != getpid()) return -1;
+
+    struct connection *owned = (struct connection *)malloc(sizeof(struct connection));
+    if (!owned) return -1;
+    *owned = *c;
+
+    pthread_mutex_lock(&writer_lock);
+    owned->prev = NULL;
+    owned->next = writer_conns;
+    if (writer_conns) writer_conns->prev = owned;
+    writer_conns = owned;
+    pthread_mutex_unlock(&writer_lock);
+
+    struct epoll_event ev;
+    ev.events = EPOLLOUT;
+    ev.data.ptr = owned;
+    if (epoll_ctl(writer_epfd, EPOLL_CTL_ADD, owned->fd, &ev) < 0) {
+        unlink_conn(owned);
+        free(owned);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,24 @@
+#ifndef SLOW_WRITER_H
+#define SLOW_WRITER_H
+
+#include "server_core.h"
+
+/*
+ * Write-behind event loop for backends with a fixed number of blocking
+ * workers (pool, prefork). A response that does not fit in the socket
+ * buffer is adopted by one epoll thread that finishes it with EPOLLOUT,
+ * so a slow client holds at most OUTPUT_QUEUE_LIMIT bytes of memory
+ * rather than a worker. Connections below MIN_TRANSFER_RATE are closed.
+ */
+
+// Start the writer thread in this process.
+int slow_writer_start(void);
+// Take over a connection in CONN_WRITING on a non-blocking socket. The
+// connection is copied; the caller must not touch or close it after a
+// successful (0) return. Returns -1 if no writer runs in this process.
+int slow_writer_adopt(const struct connection *c);
+// Call hook from the writer thread each time it closes an adopted
+// connection. Set it before slow_writer_start().
+void slow_writer_set_done_hook(void (*hook)(void));
+
+#endif
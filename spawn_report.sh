@@ -0,0 +1,56 @@
+#!/bin/bash
+
+## Compare the fork and spawn backends as the server's address space grows.
+## For each SERVER_BALLAST_MB size it runs serverbench with both backends,
+## sends requests, and reads the process creation time (fork() or
+## posix_spawn()) percentiles from the child tracker's SIGUSR1 report.
+## Requests/s are measured with ab when it is installed; otherwise curl
+## drives the load and only the creation times are reported.
+## Writes spawn_report.txt.
+
+src=$(dirname "$(readlink -f "$0")")
+port=${port:-18780}
+REQUESTS=${REQUESTS:-5000}
+CONC=${CONC:-8}
+BALLAST=${BALLAST:-"0 64 256 1024"}
+
+cd "$src" || exit 1
+for bin in serverbench serverhandler; do
+    if [[ ! -x ./$bin ]]; then
+	echo "ERROR: ./$bin is missing, run 'make'."
+	exit 1
+    fi
+done
+head -c 10000 < /dev/urandom > big
+
+printf "%-10s %-7s %12s %10s %10s %10s\n" "ballast_mb" "backend" "rps" "create_p50" "create_p99" "create_max" | tee spawn_report.txt
+for mb in $BALLAST; do
+    for backend in fork spawn; do
+	SERVER_BALLAST_MB=$mb ./serverbench 127.0.0.1:$port $backend 2> tmp.stats > /dev/null &
+	pid=$!
+	## The ballast is touched before the socket is bound.
+	for ((k=0;k<100;k++)); do
+	    curl -s -o /dev/null http://127.0.0.1:$port/big && break
+	    sleep 0.1
+	done
+	if command -v ab > /dev/null; then
+	    rps=$(ab -n $REQUESTS -c $CONC http://127.0.0.1:$port/big 2>/dev/null | awk '/Requests per second/ {print $4}')
+	else
+	    rps=-
+	    for ((k=0;k<REQUESTS/10;k++)); do
+		curl -s http://127.0.0.1:$port/big > /dev/null
+	    done
+	fi
+	kill -USR1 $pid
+	sleep 0.2
+	kill -TERM $pid
+	wait $pid
+	## First report line with the creation times ('fork_us').
+	awk -v m=$mb -v b=$backend -v r=$rps '/fork_us/ && !done {
+		for (i = 1; i <= NF; i++) { split($i, kv, "="); v[kv[1]] = kv[2] }
+		printf "%-10s %-7s %12s %10s %10s %10s\n", m, b, r, v["p50"], v["p99"], v["max"]; done = 1 }' tmp.stats |
+	    tee -a spawn_report.txt
+	port=$((port + 1))
+    done
+done
+rm -f tmp.stats
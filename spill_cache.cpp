@@ -0,0 +1,366 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "spill_cache.h"
+#include "server_core.h"
+
+struct spill_job {
+    struct cache_entry *entry;      // evicted entry, referenced; NULL for a file
+    char path[256];                 // file jobs only
+    size_t len;
+    unsigned int hash;
+    struct stat st;
+};
+
+static const char *spill_dir;
+static off_t segment_bytes;
+static int running;
+static pid_t running_pid;         // the process the writer runs in
+static pthread_mutex_t start_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_ready = PTHREAD_COND_INITIALIZER;
+static struct spill_job queue[SPILL_QUEUE];
+static unsigned int queue_head, queue_len;
+
+static pthread_mutex_t index_lock = PTHREAD_MUTEX_INITIALIZER;     // index writers
+static struct flat_index spill_index;
+static struct spill_segment *segments[SPILL_SEGMENTS];              // writer thread only
+static int current;
+
+static unsigned long long written, written_bytes, dropped, recycled, indexed;
+
+// Hits are counted per thread and added up at thread exit or every
+// TIER_FLUSH_EVERY hits.
+#define TIER_FLUSH_EVERY 64
+
+struct tier_counts {
+    unsigned long long hits[CACHE_TIERS];
+    unsigned int pending;
+};
+
+static unsigned long long tier_hits[CACHE_TIERS];
+static __thread struct tier_counts local_hits;
+static __thread int local_registered;
+static pthread_key_t tier_key;
+static pthread_once_t tier_once = PTHREAD_ONCE_INIT;
+
+static void flush_hits(void *arg) {
+    struct tier_counts *counts = (struct tier_counts *)arg;
+    for (int i = 0; i < CACHE_TIERS; ++i) {
+        __atomic_fetch_add(&tier_hits[i], counts->hits[i], __ATOMIC_RELAXED);
+        counts->hits[i] = 0;
+    }
+    counts->pending = 0;
+}
+
+static void create_tier_key(void) {
+    pthread_key_create(&tier_key, flush_hits);
+}
+
+void cache_tier_count(enum cache_tier tier) {
+    if (!running) return;
+    if (!local_registered) {
+        pthread_once(&tier_once, create_tier_key);
+        pthread_setspecific(tier_key, &local_hits);
+        local_registered = 1;
+    }
+    local_hits.hits[tier]++;
+    if (++local_hits.pending == TIER_FLUSH_EVERY) flush_hits(&local_hits);
+}
+
+static int same_version(const struct stat *a, const struct stat *b) {
+    return a->st_size == b->st_size && a->st_mtim.tv_sec == b->st_mtim.tv_sec &&
+           a->st_mtim.tv_nsec == b->st_mtim.tv_nsec && a->st_ino == b->st_ino;
+}
+
+void spill_segment_ref(struct spill_segment *segment) {
+    __atomic_fetch_add(&segment->refs, 1, __ATOMIC_RELAXED);
+}
+
+void spill_segment_release(struct spill_segment *segment) {
+    if (__atomic_sub_fetch(&segment->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        close(segment->fd);
+        free(segment);
+    }
+}
+
+// After the grace period nobody can find the segment's entries.
+static void reclaim_segment(struct ebr_node *node) {
+    struct spill_segment *segment = (struct spill_segment *)node;      // 'retired' is the first member
+    while (segment->entries) {
+        struct spill_entry *e = segment->entries;
+        segment->entries = e->segment_next;
+        index_key_release(&e->key);
+        free(e);
+    }
+    spill_segment_release(segment);
+}
+
+// Caller holds index_lock.
+static void unlink_entry(struct spill_entry *e) {
+    flat_index_remove(&spill_index, &e->key);
+    __atomic_store_n(&e->linked, 0, __ATOMIC_RELEASE);
+    indexed--;
+}
+
+// An unlinked file in the spill directory; it goes away with its last fd.
+static struct spill_segment *open_segment(void) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/spill.XXXXXX", spill_dir);
+    int fd = mkostemp(path, O_CLOEXEC);
+    if (fd < 0) return NULL;
+    unlink(path);
+    struct spill_segment *segment = (struct spill_segment *)calloc(1, sizeof(struct spill_segment));
+    if (!segment) {
+        close(fd);
+        return NULL;
+    }
+    segment->fd = fd;
+    segment->refs = 1;
+    return segment;
+}
+
+// Drop the oldest segment and everything indexed in it.
+static void recycle_segment(struct spill_segment *segment) {
+    pthread_mutex_lock(&index_lock);
+    for (struct spill_entry *e = segment->entries; e; e = e->segment_next)
+        if (e->linked) unlink_entry(e);
+    pthread_mutex_unlock(&index_lock);
+    ebr_retire(&segment->retired, reclaim_segment);
+    recycled++;
+}
+
+static struct spill_segment *segment_with_room(off_t size) {
+    if (segments[current]->used + size <= segment_bytes) return segments[current];
+    int next = (current + 1) % SPILL_SEGMENTS;
+    if (segments[next]) {
+        recycle_segment(segments[next]);
+        segments[next] = NULL;
+    }
+    segments[next] = open_segment();
+    if (!segments[next]) {
+        log_error("spill segment open failed", 0);
+        return NULL;
+    }
+    current = next;
+    return segments[current];
+}
+
+static int write_all(int fd, const char *data, size_t size, off_t offset) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pwrite(fd, data + done, size - done, offset + done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        done += n;
+    }
+    return 0;
+}
+
+// Copy the file at path into fd at offset, if it is still the version in st.
+static int copy_file(const char *path, const struct stat *st, int fd, off_t offset, char *buf) {
+    int src = open(path, O_RDONLY | O_CLOEXEC);
+    if (src < 0) return -1;
+    struct stat now;
+    if (fstat(src, &now) < 0 || !same_version(&now, st)) {
+        close(src);
+        return -1;
+    }
+    off_t in = 0, out = offset;
+    size_t left = st->st_size;
+    // In the kernel where the filesystems allow it; otherwise through buf.
+    while (left > 0) {
+        ssize_t n = copy_file_range(src, &in, fd, &out, left, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        left -= n;
+    }
+    while (left > 0) {
+        ssize_t n = pread(src, buf, left < SPILL_COPY_CHUNK ? left : SPILL_COPY_CHUNK, in);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0 || write_all(fd, buf, n, out) < 0) break;
+        in += n;
+        out += n;
+        left -= n;
+    }
+    close(src);
+    return left == 0 ? 0 : -1;
+}
+
+static struct spill_entry *find(const char *path, size_t len, unsigned int hash) {
+    return (struct spill_entry *)flat_index_find(&spill_index, path, len, hash);
+}
+
+static void write_job(struct spill_job *job, char *buf) {
+    const char *path = job->entry ? job->entry->key.str : job->path;
+    // Several requests may queue the same file; write it once per version.
+    // Entries and tables are only retired by this thread, so its lookups
+    // need no section.
+    struct spill_entry *old = find(path, job->len, job->hash);
+    if (old && same_version(&old->st, &job->st)) return;
+
+    size_t size = job->st.st_size;
+    struct spill_segment *segment = segment_with_room(size);
+    if (!segment) return;
+    int failed = job->entry ? write_all(segment->fd, job->entry->data, size, segment->used)
+                            : copy_file(path, &job->st, segment->fd, segment->used, buf);
+    if (failed) return;
+
+    struct spill_entry *e = (struct spill_entry *)calloc(1, sizeof(struct spill_entry));
+    if (!e) return;
+    e->segment = segment;
+    e->offset = segment->used;
+    e->size = size;
+    e->st = job->st;
+    e->checked_ms = monotonic_ms();
+    e->linked = 1;
+    segment->used += size;
+
+    pthread_mutex_lock(&index_lock);
+    old = find(path, job->len, job->hash);
+    if (old) {
+        index_key_share(&e->key, &old->key);
+        unlink_entry(old);
+    } else if (index_key_intern(&spill_index, &e->key, path, job->len, job->hash) < 0) {
+        pthread_mutex_unlock(&index_lock);
+        free(e);
+        return;
+    }
+    if (flat_index_insert(&spill_index, &e->key) < 0) {
+        pthread_mutex_unlock(&index_lock);
+        index_key_release(&e->key);
+        free(e);
+        return;
+    }
+    indexed++;
+    pthread_mutex_unlock(&index_lock);
+    // The segment owns the entry from here; a replaced one stays until it goes.
+    e->segment_next = segment->entries;
+    segment->entries = e;
+    written++;
+    written_bytes += size;
+}
+
+static void *spill_writer(void *arg) {
+    (void)arg;
+    char *buf = (char *)malloc(SPILL_COPY_CHUNK);
+    if (!buf) log_error("spill buffer malloc failed", 1);
+
+    while (1) {
+        pthread_mutex_lock(&queue_lock);
+        while (queue_len == 0) pthread_cond_wait(&queue_ready, &queue_lock);
+        struct spill_job job = queue[queue_head];
+        queue_head = (queue_head + 1) % SPILL_QUEUE;
+        queue_len--;
+        pthread_mutex_unlock(&queue_lock);
+
+        write_job(&job, buf);
+        if (job.entry) file_cache_release(job.entry);
+    }
+    return NULL;
+}
+
+static int push_job(const struct spill_job *job) {
+    pthread_mutex_lock(&queue_lock);
+    if (queue_len == SPILL_QUEUE) {
+        dropped++;
+        pthread_mutex_unlock(&queue_lock);
+        return -1;
+    }
+    queue[(queue_head + queue_len) % SPILL_QUEUE] = *job;
+    queue_len++;
+    pthread_cond_signal(&queue_ready);
+    pthread_mutex_unlock(&queue_lock);
+    return 0;
+}
+
+// Eviction hook of the memory tier, under its shard lock.
+static void offer_entry(struct cache_entry *e) {
+    if ((off_t)e->size > segment_bytes) return;
+    struct spill_job job;
+    job.entry = e;
+    job.len = e->key.len;
+    job.hash = e->key.hash;
+    job.st = e->st;
+    file_cache_ref(e);
+    if (push_job(&job) < 0) file_cache_release(e);
+}
+
+void spill_cache_offer_file(const char *path, size_t len, unsigned int hash, const struct stat *st) {
+    struct spill_job job;
+    if (!running || st->st_size > segment_bytes || len >= sizeof(job.path)) return;
+    job.entry = NULL;
+    memcpy(job.path, path, len + 1);
+    job.len = len;
+    job.hash = hash;
+    job.st = *st;
+    push_job(&job);
+}
+
+struct spill_entry *spill_cache_lookup(const char *path, size_t len, unsigned int hash, long long now_ms) {
+    if (!running) return NULL;
+    struct spill_entry *e = find(path, len, hash);
+    if (!e) return NULL;
+    if (now_ms - __atomic_load_n(&e->checked_ms, __ATOMIC_RELAXED) >= FILE_CACHE_VALIDATE_MS) {
+        struct stat st;
+        if (stat(path, &st) < 0 || !same_version(&st, &e->st)) {
+            pthread_mutex_lock(&index_lock);
+            if (e->linked) unlink_entry(e);
+            pthread_mutex_unlock(&index_lock);
+            return NULL;
+        }
+        __atomic_store_n(&e->checked_ms, now_ms, __ATOMIC_RELAXED);
+    }
+    return e;
+}
+
+void spill_cache_configure(const char *dir, unsigned long long bytes) {
+    spill_dir = dir;
+    segment_bytes = (bytes ? bytes : SPILL_DEFAULT_BYTES) / SPILL_SEGMENTS;
+}
+
+int spill_cache_start(void) {
+    pthread_mutex_lock(&start_lock);
+    int ret = 0;
+    // A forked child inherits running_pid but not the writer.
+    if (spill_dir && running_pid != getpid()) {
+        flat_index_init(&spill_index);
+        current = 0;
+        segments[0] = open_segment();
+        if (!segments[0] || start_background_thread(spill_writer, NULL) < 0) {
+            ret = -1;
+        } else {
+            file_cache_set_evict_hook(offer_entry);
+            running = 1;
+            running_pid = getpid();
+        }
+    }
+    pthread_mutex_unlock(&start_lock);
+    return ret;
+}
+
+int spill_cache_running(void) {
+    return running;
+}
+
+void spill_cache_report(FILE *out) {
+    if (!running) return;
+    flush_hits(&local_hits);
+    static const char *names[CACHE_TIERS] = { "memory", "spill", "origin" };
+    unsigned long long hits[CACHE_TIERS], total = 0;
+    for (int i = 0; i < CACHE_TIERS; ++i) total += hits[i] = __atomic_load_n(&tier_hits[i], __ATOMIC_RELAXED);
+
+    fprintf(out, "[%d] cache tiers:", (int)getpid());
+    for (int i = 0; i < CACHE_TIERS; ++i)
+        fprintf(out, " %s %llu (%.1f%%)", names[i], hits[i], total ? 100.0 * hits[i] / total : 0.0);
+    fprintf(out, "\n[%d] spill log: %llu objects (%llu MiB) written, %llu dropped, %llu segments recycled, "
+                 "%llu indexed\n",
+            (int)getpid(), __atomic_load_n(&written, __ATOMIC_RELAXED),
+            __atomic_load_n(&written_bytes, __ATOMIC_RELAXED) >> 20, __atomic_load_n(&dropped, __ATOMIC_RELAXED),
+            __atomic_load_n(&recycled, __ATOMIC_RELAXED), __atomic_load_n(&indexed, __ATOMIC_RELAXED));
+}
@@ -0,0 +1,85 @@
+#ifndef SPILL_CACHE_H
+#define SPILL_CACHE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "ebr.h"
+#include "flat_index.h"
+#include "file_cache.h"
+
+/*
+ * Second cache tier on a local disk, for working sets larger than the
+ * memory tier (file_cache.h) when the document root is on slow storage.
+ *
+ * Two kinds of object are copied into a log on the spill directory:
+ * entries evicted from the memory tier, and files too large for it, up to
+ * the size of a segment. The log is SPILL_SEGMENTS unlinked files that are
+ * filled in turn. When the log wraps, the oldest segment is dropped
+ * together with everything indexed in it. All writes happen on one
+ * background thread per process. Requests only queue a job, and jobs are
+ * dropped when SPILL_QUEUE is full.
+ *
+ * The in-memory index is a flat_index, read without locks under EBR like
+ * the memory tier. An entry is re-checked with stat() at the same interval.
+ * Responses are sent from the segment with sendfile() at the entry's
+ * offset, holding a reference so a recycled segment stays open until they
+ * finish. A small object is promoted back into the memory tier when it is
+ * hit.
+ *
+ * Hits are counted per tier: memory, spill and origin (the document root).
+ * spill_cache_report() writes the ratios.
+ */
+
+#define SPILL_SEGMENTS 16
+#define SPILL_DEFAULT_BYTES (4096ull << 20)
+#define SPILL_QUEUE 256
+#define SPILL_COPY_CHUNK (1024 * 1024)
+
+enum cache_tier { TIER_MEMORY, TIER_SPILL, TIER_ORIGIN, CACHE_TIERS };
+
+struct spill_entry;
+
+struct spill_segment {
+    struct ebr_node retired;
+    int fd;
+    int refs;                       // the log's, until retired, plus one per response
+    off_t used;
+    struct spill_entry *entries;    // everything written here, indexed or not
+};
+
+struct spill_entry {
+    struct index_key key;           // the path; first, so the index's pointer is the entry's
+    struct spill_entry *segment_next;
+    struct spill_segment *segment;
+    off_t offset;
+    size_t size;
+    struct stat st;
+    long long checked_ms;
+    int linked;                     // still in the index
+};
+
+// Record the spill directory and size (0 = SPILL_DEFAULT_BYTES) for
+// spill_cache_start(). A NULL dir leaves the tier off.
+void spill_cache_configure(const char *dir, unsigned long long bytes);
+// Start the writer thread in this process, once. Processes that never call
+// it, such as forked per-connection children, have no spill tier.
+int spill_cache_start(void);
+int spill_cache_running(void);
+
+// Inside an EBR section: entry for path, or NULL when it is not spilled or
+// has changed on disk.
+struct spill_entry *spill_cache_lookup(const char *path, size_t len, unsigned int hash, long long now_ms);
+// Queue a copy of a file too large for the memory tier.
+void spill_cache_offer_file(const char *path, size_t len, unsigned int hash, const struct stat *st);
+// Keep a segment open for a response (taken inside the section).
+void spill_segment_ref(struct spill_segment *segment);
+void spill_segment_release(struct spill_segment *segment);
+
+void cache_tier_count(enum cache_tier tier);
+// Hit ratios per tier and spill log counters; nothing when the tier is off.
+void spill_cache_report(FILE *out);
+
+#endif
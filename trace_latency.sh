@@ -0,0 +1,88 @@
+#!/bin/bash
+
+## Latency breakdown of a live server from its USDT probes (see probes.h).
+## Needs bpftrace and a server built with <sys/sdt.h> available.
+##
+##   sudo ./trace_latency.sh ./serverthread
+##   sudo ./trace_latency.sh ./serverfork
+##
+## Ctrl-C prints one histogram (in microseconds) per request stage.
+
+if [[ -z "$1" ]]; then
+    echo "Usage: $0 <server binary>"
+    exit 1
+fi
+bin=$(readlink -f "$1")
+
+## In the forked server 'accept' fires in the parent and the rest in the
+## child, so the accept timestamp is looked up under the parent's pid when
+## the child has none of its own.
+bpftrace -e "
+usdt:$bin:webserver:accept
+{
+    @acc[pid, arg0] = nsecs;
+}
+
+usdt:$bin:webserver:request_parsed
+{
+    \$t = @acc[pid, arg0];
+    if (\$t == 0) {
+        \$t = @acc[curtask->real_parent->tgid, arg0];
+        delete(@acc[curtask->real_parent->tgid, arg0]);
+    } else {
+        delete(@acc[pid, arg0]);
+    }
+    if (\$t != 0) {
+        @accept_to_parsed_us = hist((nsecs - \$t) / 1000);
+        @start[pid, arg0] = \$t;
+    }
+    @parsed[pid, arg0] = nsecs;
+    @paths[str(arg1)] = count();
+}
+
+usdt:$bin:webserver:file_opened
+/@parsed[pid, arg0]/
+{
+    @parsed_to_opened_us = hist((nsecs - @parsed[pid, arg0]) / 1000);
+    @opened[pid, arg0] = nsecs;
+    @file_size = hist(arg2);
+}
+
+usdt:$bin:webserver:headers_sent
+/@opened[pid, arg0]/
+{
+    @opened_to_headers_us = hist((nsecs - @opened[pid, arg0]) / 1000);
+    @headers[pid, arg0] = nsecs;
+}
+
+usdt:$bin:webserver:headers_sent
+{
+    @status[arg1] = count();
+}
+
+usdt:$bin:webserver:body_done
+/@headers[pid, arg0]/
+{
+    @headers_to_body_us = hist((nsecs - @headers[pid, arg0]) / 1000);
+}
+
+usdt:$bin:webserver:close
+{
+    if (@start[pid, arg0]) {
+        @accept_to_close_us = hist((nsecs - @start[pid, arg0]) / 1000);
+    }
+    delete(@start[pid, arg0]);
+    delete(@parsed[pid, arg0]);
+    delete(@opened[pid, arg0]);
+    delete(@headers[pid, arg0]);
+}
+
+END
+{
+    clear(@acc);
+    clear(@start);
+    clear(@parsed);
+    clear(@opened);
+    clear(@headers);
+}
+"
@@ -0,0 +1,138 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "version_table.h"
+#include "file_cache.h"
+#include "server_core.h"
+
+enum slot_state { SLOT_EMPTY, SLOT_PENDING, SLOT_READY };
+
+// The result follows each slot, so slots are slot_stride bytes apart.
+struct version_slot {
+    int lock;
+    int state;
+    struct path_version version;
+    size_t len;
+};
+
+static void slot_lock(struct version_slot *s) {
+    while (__atomic_test_and_set(&s->lock, __ATOMIC_ACQUIRE)) {}
+}
+
+static void slot_unlock(struct version_slot *s) {
+    __atomic_clear(&s->lock, __ATOMIC_RELEASE);
+}
+
+static char *slot_result(struct version_slot *s) {
+    return (char *)(s + 1);
+}
+
+static struct version_slot *slot_for(struct version_table *t, const char *path) {
+    size_t i = file_cache_hash(path) % t->slot_count;
+    return (struct version_slot *)((char *)t->slots + i * t->slot_stride);
+}
+
+static int slot_matches(const struct version_slot *s, const char *path, const struct stat *st) {
+    const struct path_version *v = &s->version;
+    return s->state != SLOT_EMPTY && v->size == st->st_size && v->mtime_sec == st->st_mtim.tv_sec &&
+           v->mtime_nsec == st->st_mtim.tv_nsec && strcmp(v->path, path) == 0;
+}
+
+static int slot_holds(const struct version_slot *s, const struct path_version *v) {
+    const struct path_version *held = &s->version;
+    return s->state == SLOT_PENDING && held->size == v->size && held->mtime_sec == v->mtime_sec &&
+           held->mtime_nsec == v->mtime_nsec && strcmp(held->path, v->path) == 0;
+}
+
+int path_version_matches(const struct path_version *v, const struct stat *st) {
+    return S_ISREG(st->st_mode) && st->st_size == v->size && st->st_mtim.tv_sec == v->mtime_sec &&
+           st->st_mtim.tv_nsec == v->mtime_nsec;
+}
+
+static void *version_worker(void *arg) {
+    struct version_table *t = (struct version_table *)arg;
+    char *result = (char *)malloc(t->result_size);
+    if (!result) return NULL;
+    while (1) {
+        pthread_mutex_lock(&t->queue_lock);
+        while (t->queue_count == 0) pthread_cond_wait(&t->queue_ready, &t->queue_lock);
+        struct path_version v = t->queue[t->queue_head];
+        t->queue_head = (t->queue_head + 1) % t->queue_size;
+        t->queue_count--;
+        pthread_mutex_unlock(&t->queue_lock);
+
+        int len = t->job(&v, result);
+        struct version_slot *s = slot_for(t, v.path);
+        slot_lock(s);
+        if (slot_holds(s, &v)) {
+            if (len >= 0) {
+                memcpy(slot_result(s), result, len);
+                s->len = len;
+            }
+            s->state = len >= 0 ? SLOT_READY : SLOT_EMPTY;
+        }
+        slot_unlock(s);
+    }
+    return NULL;
+}
+
+int version_table_start(struct version_table *t, int threads) {
+    pthread_mutex_lock(&t->start_lock);
+    int ret = 0;
+    // A forked child inherits running_pid but not the threads.
+    if (t->running_pid != getpid()) {
+        if (!t->slots) {
+            // Keep each result aligned for the job's own types.
+            t->slot_stride = (sizeof(struct version_slot) + t->result_size + 7) & ~(size_t)7;
+            t->slots = (struct version_slot *)calloc(t->slot_count, t->slot_stride);
+            t->queue = (struct path_version *)calloc(t->queue_size, sizeof(*t->queue));
+        }
+        int started = 0;
+        while (t->slots && t->queue && started < threads && start_background_thread(version_worker, t) == 0)
+            started++;
+        if (started) __atomic_store_n(&t->running_pid, getpid(), __ATOMIC_RELEASE);
+        ret = started == threads ? 0 : -1;
+    }
+    pthread_mutex_unlock(&t->start_lock);
+    return ret;
+}
+
+int version_table_lookup(struct version_table *t, const char *path, const struct stat *st, void *result,
+                         size_t result_size) {
+    if (__atomic_load_n(&t->running_pid, __ATOMIC_ACQUIRE) != getpid() ||
+        strlen(path) >= sizeof(t->queue[0].path))
+        return -1;
+    struct version_slot *s = slot_for(t, path);
+    slot_lock(s);
+    if (slot_matches(s, path, st)) {
+        int len = s->state == SLOT_READY && s->len <= result_size ? (int)s->len : -1;
+        if (len > 0) memcpy(result, slot_result(s), len);
+        slot_unlock(s);
+        return len;
+    }
+    // Claim the slot for this version, then queue it outside the spinlock.
+    struct path_version *v = &s->version;
+    strcpy(v->path, path);
+    v->size = st->st_size;
+    v->mtime_sec = st->st_mtim.tv_sec;
+    v->mtime_nsec = st->st_mtim.tv_nsec;
+    s->state = SLOT_PENDING;
+    struct path_version job = *v;
+    slot_unlock(s);
+
+    pthread_mutex_lock(&t->queue_lock);
+    int queued = t->queue_count < t->queue_size;
+    if (queued) {
+        t->queue[(t->queue_head + t->queue_count++) % t->queue_size] = job;
+        pthread_cond_signal(&t->queue_ready);
+    }
+    pthread_mutex_unlock(&t->queue_lock);
+    if (!queued) {
+        slot_lock(s);
+        if (slot_holds(s, &job)) s->state = SLOT_EMPTY;
+        slot_unlock(s);
+    }
+    return -1;
+}
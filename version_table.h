@@ -0,0 +1,65 @@
+#ifndef VERSION_TABLE_H
+#define VERSION_TABLE_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/*
+ * Results computed once per file version by background threads, for work
+ * too slow to do in a request (etag.h, early_hints.h).
+ *
+ * A version is (path, size, mtime). The first lookup of a version claims
+ * its direct-mapped slot and queues it; a background thread runs the
+ * table's job on it and stores the result, up to result_size bytes. Slots
+ * sit behind spinlocks like the header templates. A version that loses
+ * its slot to another path is queued again when next looked up. Jobs are
+ * dropped when the queue is full, and the next lookup retries. Processes
+ * that did not call version_table_start() never find a result.
+ */
+
+struct path_version {
+    char path[256];
+    off_t size;
+    time_t mtime_sec;
+    long mtime_nsec;
+};
+
+// Compute the result for v into result (result_size bytes); returns its
+// length, or -1 to leave the version to be queued again.
+typedef int (*version_job)(const struct path_version *v, void *result);
+
+struct version_slot;
+
+struct version_table {
+    size_t slot_count;
+    size_t result_size;
+    size_t queue_size;
+    version_job job;
+    // Set up by version_table_start().
+    struct version_slot *slots;
+    size_t slot_stride;
+    struct path_version *queue;
+    size_t queue_head, queue_count;
+    pthread_mutex_t queue_lock;
+    pthread_cond_t queue_ready;
+    pid_t running_pid;          // the process the threads run in
+    pthread_mutex_t start_lock;
+};
+
+#define VERSION_TABLE_INIT(slot_count, result_size, queue_size, job)                                        \
+    { slot_count, result_size, queue_size, job, NULL, 0, NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER,             \
+      PTHREAD_COND_INITIALIZER, 0, PTHREAD_MUTEX_INITIALIZER }
+
+// Whether st (from an open file) is still version v.
+int path_version_matches(const struct path_version *v, const struct stat *st);
+// Start t's background threads (threads of them) in this process, once.
+int version_table_start(struct version_table *t, int threads);
+// Copy the result for path at version st into result; returns its length,
+// or -1 when there is none yet (the version is then queued) or it does not
+// fit in result_size bytes.
+int version_table_lookup(struct version_table *t, const char *path, const struct stat *st, void *result,
+                         size_t result_size);
+
+#endif